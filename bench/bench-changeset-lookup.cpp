@@ -0,0 +1,135 @@
+/*
+ * Benchmark for the changeset to user lookup of osmdbt-create-diff,
+ * comparing the flat changeset_user_lookup with the std::unordered_map
+ * used before. It measures the two access patterns: one insert per object
+ * read from the log and one lookup per object written to the change file.
+ *
+ * Usage: bench-changeset-lookup [NUMBER_OF_OBJECTS]
+ */
+
+#include "cslookup.hpp"
+
+#include <osmium/osm/types.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// A few thousand open changesets with runs of objects from the same
+// changeset like in real logs, and a few changesets per user.
+std::vector<osmium::changeset_id_type> synthetic_changesets(std::size_t count)
+{
+    std::vector<osmium::changeset_id_type> cids;
+    cids.reserve(count);
+
+    uint64_t state = 42;
+    osmium::changeset_id_type cid = 0;
+    for (std::size_t n = 0; n < count; ++n) {
+        if (n % 20 == 0) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            cid = 100000000 + static_cast<osmium::changeset_id_type>(
+                                  (state >> 33U) % 5000);
+        }
+        cids.push_back(cid);
+    }
+
+    return cids;
+}
+
+osmium::user_id_type user_of(osmium::changeset_id_type cid) noexcept
+{
+    return cid % 1500 + 1;
+}
+
+std::string name_of(osmium::user_id_type uid)
+{
+    return "a mapper with a name of typical length " + std::to_string(uid);
+}
+
+double ns_per_op(std::chrono::steady_clock::time_point start,
+                 std::size_t ops)
+{
+    return std::chrono::duration<double, std::nano>(
+               std::chrono::steady_clock::now() - start)
+               .count() /
+           static_cast<double>(ops);
+}
+
+void report(char const *name, std::size_t changesets, double insert_ns,
+            double lookup_ns, std::size_t checksum)
+{
+    std::cout << name << ": " << changesets << " changesets, insert "
+              << insert_ns << " ns/object, lookup " << lookup_ns
+              << " ns/object (checksum " << checksum << ")\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t const count =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+
+    auto const cids = synthetic_changesets(count);
+
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        std::unordered_map<osmium::changeset_id_type, userinfo> lookup;
+        for (auto const cid : cids) {
+            lookup[cid] = {};
+        }
+        auto const insert_ns = ns_per_op(start, cids.size());
+
+        for (auto &c : lookup) {
+            c.second.id = user_of(c.first);
+            c.second.username = name_of(c.second.id);
+        }
+
+        start = std::chrono::steady_clock::now();
+        std::size_t checksum = 0;
+        for (auto const cid : cids) {
+            auto const &user = lookup.at(cid);
+            checksum += user.id + user.username.size();
+        }
+        report("std::unordered_map", lookup.size(), insert_ns,
+               ns_per_op(start, cids.size()), checksum);
+    }
+
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        changeset_user_lookup lookup;
+        for (auto const cid : cids) {
+            lookup.add(cid);
+        }
+        auto const insert_ns = ns_per_op(start, cids.size());
+
+        std::vector<osmium::changeset_id_type> all;
+        lookup.for_each([&](osmium::changeset_id_type cid,
+                            changeset_user_lookup::user const & /*user*/) {
+            all.push_back(cid);
+        });
+        for (auto const cid : all) {
+            lookup.set_user(cid, user_of(cid), name_of(user_of(cid)));
+        }
+
+        start = std::chrono::steady_clock::now();
+        std::size_t checksum = 0;
+        for (auto const cid : cids) {
+            auto const user = lookup.get(cid);
+            checksum += user.id + user.name.size();
+        }
+        report("changeset_user_lookup", lookup.size(), insert_ns,
+               ns_per_op(start, cids.size()), checksum);
+    }
+
+    return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Benchmark for converting rows of the node query of osmdbt-create-diff
+ * into OSM objects in an osmium::memory::Buffer. The rows are generated
+ * in memory, so only the conversion is measured, not the database.
+ *
+ * Usage: bench-create-diff-rows [NUMBER_OF_NODES]
+ */
+
+#include "objrow.hpp"
+#include "osmobj.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Minimal stand-ins for pqxx::field, pqxx::row, and pqxx::result. An
+// empty value is NULL, that's good enough for the columns used here.
+
+class bench_field
+{
+public:
+    explicit bench_field(std::string const &value) noexcept : m_value(&value)
+    {}
+
+    [[nodiscard]] char const *c_str() const noexcept
+    {
+        return m_value->c_str();
+    }
+
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_value->size();
+    }
+
+    [[nodiscard]] bool is_null() const noexcept { return m_value->empty(); }
+
+private:
+    std::string const *m_value;
+
+}; // class bench_field
+
+class bench_row
+{
+public:
+    using size_type = int;
+
+    explicit bench_row(std::vector<std::string> const &values) noexcept
+    : m_values(&values)
+    {}
+
+    bench_field operator[](size_type column) const noexcept
+    {
+        return bench_field{(*m_values)[static_cast<std::size_t>(column)]};
+    }
+
+private:
+    std::vector<std::string> const *m_values;
+
+}; // class bench_row
+
+struct bench_result
+{
+    std::vector<std::string> columns{"node_id",   "latitude",     "longitude",
+                                     "version",   "changeset_id", "visible",
+                                     "timestamp", "redaction_id"};
+    std::vector<std::vector<std::string>> rows;
+
+    [[nodiscard]] int column_number(char const *name) const
+    {
+        auto const it = std::find(columns.begin(), columns.end(), name);
+        if (it == columns.end()) {
+            throw std::runtime_error{std::string{"Unknown column "} + name};
+        }
+        return static_cast<int>(it - columns.begin());
+    }
+};
+
+bench_result synthetic_nodes(std::size_t count,
+                             changeset_user_lookup *cucache)
+{
+    bench_result result;
+    result.rows.reserve(count);
+
+    for (std::size_t n = 0; n < count; ++n) {
+        auto const cid = static_cast<osmium::changeset_id_type>(1000 + n / 100);
+        result.rows.push_back({std::to_string(1000000000 + n),
+                               std::to_string(515000000 + n % 1000),
+                               std::to_string(-1000000 + n % 1000),
+                               std::to_string(1 + n % 5), std::to_string(cid),
+                               "t", std::to_string(1600000000 + n), ""});
+        auto const uid = static_cast<osmium::user_id_type>(cid % 1000);
+        cucache->set_user(cid, uid, "user" + std::to_string(uid));
+    }
+
+    return result;
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t const nodes =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    changeset_user_lookup cucache;
+    auto const result = synthetic_nodes(nodes, &cucache);
+
+    auto const start = std::chrono::steady_clock::now();
+
+    osmium::memory::Buffer buffer{1024UL * 1024UL,
+                                  osmium::memory::Buffer::auto_grow::yes};
+
+    node_columns<bench_row> const cols{result};
+    osmium::Timestamp max_timestamp{};
+    for (auto const &values : result.rows) {
+        bench_row const row{values};
+        auto const id = cols.id(row);
+        auto const version = cols.version(row);
+        auto const timestamp = cols.timestamp(row);
+
+        if (timestamp > max_timestamp) {
+            max_timestamp = timestamp;
+        }
+
+        if (cols.is_redacted(row)) {
+            continue;
+        }
+
+        {
+            osmium::builder::NodeBuilder builder{buffer};
+            builder.set_location(cols.location(row));
+            cols.set_attributes(builder, row, cucache, id, version, timestamp);
+            osmium::builder::TagListBuilder tl_builder{builder};
+            tl_builder.add_tag("amenity", "bench");
+        }
+        buffer.commit();
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    auto const ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count();
+
+    std::cout << "Converted " << nodes << " nodes (" << buffer.committed()
+              << " bytes of buffer, newest " << max_timestamp.to_iso()
+              << ") in " << ns / 1000000 << " ms: "
+              << static_cast<double>(ns) / static_cast<double>(nodes)
+              << " ns/node\n";
+
+    return 0;
+}
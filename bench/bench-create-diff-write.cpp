@@ -0,0 +1,145 @@
+/*
+ * Benchmark for writing the change file of osmdbt-create-diff: building
+ * all objects of a batch into one buffer that is written at the end
+ * compared to handing buffers to the writer whenever they are filled
+ * beyond the flush size and the operation (create or modify) changes, so
+ * they are compressed while the next objects are built.
+ *
+ * Reading from the database is simulated by waiting some microseconds per
+ * 1000 objects. The change file is written to the current directory and
+ * removed at the end. The wall-clock time includes closing the writer.
+ *
+ * Usage: bench-create-diff-write [NUMBER_OF_NODES [FETCH_WAIT_US
+ *                                 [BATCH_SIZE]]]
+ */
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/xml_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/location.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// Same sizes as in osmdbt-create-diff
+constexpr std::size_t const buffer_size = 1024UL * 1024UL;
+constexpr std::size_t const flush_size = buffer_size * 3UL / 4UL;
+
+osmium::object_version_type node_version(std::size_t n)
+{
+    return static_cast<osmium::object_version_type>(1 + n % 5);
+}
+
+void add_node(osmium::memory::Buffer *buffer, std::size_t n)
+{
+    {
+        osmium::builder::NodeBuilder builder{*buffer};
+        builder.set_id(static_cast<osmium::object_id_type>(1000000000 + n))
+            .set_version(node_version(n))
+            .set_changeset(
+                static_cast<osmium::changeset_id_type>(1000 + n / 100))
+            .set_visible(true)
+            .set_uid(static_cast<osmium::user_id_type>(n / 100 % 1000))
+            .set_timestamp(
+                osmium::Timestamp{static_cast<uint32_t>(1600000000 + n)});
+        builder.set_user("a mapper with a name of typical length");
+        builder.set_location(osmium::Location{
+            static_cast<int32_t>(-1000000 + n % 100000),
+            static_cast<int32_t>(515000000 + n % 100000)});
+        osmium::builder::TagListBuilder tl_builder{builder};
+        tl_builder.add_tag("amenity", "bench");
+        tl_builder.add_tag("name", "Node " + std::to_string(n));
+    }
+    buffer->commit();
+}
+
+/**
+ * Build the nodes in batches and write them to the file. If incremental
+ * is set, buffers are written whenever they are filled beyond flush_size
+ * before a node with another operation, otherwise once per batch.
+ *
+ * @returns wall-clock time in milliseconds.
+ */
+double run(std::string const &filename, std::size_t nodes,
+           unsigned int fetch_wait_us, std::size_t batch_size,
+           bool incremental)
+{
+    auto const start = std::chrono::steady_clock::now();
+
+    osmium::io::Header header;
+    header.set_has_multiple_object_versions(true);
+    osmium::io::Writer writer{filename, header, osmium::io::overwrite::allow};
+
+    for (std::size_t first = 0; first < nodes; first += batch_size) {
+        auto const last = std::min(nodes, first + batch_size);
+        osmium::memory::Buffer buffer{buffer_size,
+                                      osmium::memory::Buffer::auto_grow::yes};
+        for (std::size_t n = first; n < last; ++n) {
+            if (fetch_wait_us > 0 && n % 1000 == 0) {
+                std::this_thread::sleep_for(
+                    std::chrono::microseconds{fetch_wait_us});
+            }
+            // The XML writer starts a new block with each buffer
+            bool const op_changes =
+                n > first &&
+                (node_version(n) == 1) != (node_version(n - 1) == 1);
+            if (incremental && op_changes &&
+                buffer.committed() >= flush_size) {
+                writer(std::move(buffer));
+                buffer = osmium::memory::Buffer{
+                    buffer_size, osmium::memory::Buffer::auto_grow::yes};
+            }
+            add_node(&buffer, n);
+        }
+        if (buffer.committed() > 0) {
+            writer(std::move(buffer));
+        }
+    }
+
+    writer.close();
+
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t const nodes =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+    auto const fetch_wait_us = static_cast<unsigned int>(
+        argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500);
+    std::size_t const batch_size = std::max<std::size_t>(
+        argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 100000, 1);
+
+    std::string const filename{"bench-create-diff-write.osc.gz"};
+
+    std::cout << nodes << " nodes, " << fetch_wait_us
+              << " us fetch wait per 1000 nodes, batches of " << batch_size
+              << " nodes\n";
+
+    auto const at_end = run(filename, nodes, fetch_wait_us, batch_size, false);
+    std::cout << "one buffer per batch: " << at_end << " ms\n";
+
+    auto const incremental =
+        run(filename, nodes, fetch_wait_us, batch_size, true);
+    std::cout << "flush at " << flush_size << " bytes: " << incremental
+              << " ms\n";
+
+    std::remove(filename.c_str());
+
+    return 0;
+}
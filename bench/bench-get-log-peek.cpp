@@ -0,0 +1,143 @@
+/*
+ * Benchmark for reading a replication slot like osmdbt-get-log does: all
+ * changes are peeked from the slot and decoded into log lines. It
+ * compares the result in text format with the data hex encoded by the
+ * server and decoded again in osmdbt against the result in binary format,
+ * where the data is handed to the decoder as it is. The time for the
+ * query (including decoding the WAL on the server and transferring the
+ * result) is reported separately from the time to decode the result.
+ *
+ * The changes stay in the slot, so both variants read the same changes.
+ * Use a database with a slot and publication set up by
+ * osmdbt-enable-replication and a large number of changes in the slot.
+ *
+ * Usage: bench-get-log-peek CONNINFO [SLOT [PUBLICATION]]
+ */
+
+#include "pgoutput.hpp"
+#include "pq.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// This is how the data was decoded when it was read in text format
+std::vector<char> hex2bytes(std::string_view hex)
+{
+    std::vector<char> bytes;
+    bytes.reserve(hex.size() / 2);
+
+    // mapping of ASCII characters to hex values
+    constexpr std::uint8_t const hashmap[] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, // 01234567
+        0x08, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 89:;<=>?
+        0x00, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x00, // @ABCDEFG
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // HIJKLMNO
+    };
+
+    for (std::size_t pos = 0; pos + 1 < hex.size(); pos += 2) {
+        auto const idx0 = static_cast<std::uint8_t>((hex[pos] & 0x1F) ^ 0x10);
+        auto const idx1 =
+            static_cast<std::uint8_t>((hex[pos + 1] & 0x1F) ^ 0x10);
+        bytes.push_back(static_cast<char>((hashmap[idx0] << 4U) |
+                                          hashmap[idx1]));
+    }
+
+    return bytes;
+}
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+struct run_result
+{
+    double query_ms = 0;
+    double decode_ms = 0;
+    int rows = 0;
+    std::size_t result_bytes = 0;
+    std::size_t log_bytes = 0;
+};
+
+run_result run(pq::connection *db, std::string const &slot,
+               std::string const &publication, bool binary)
+{
+    std::string const select{
+        std::string{binary ? "SELECT lsn::text, data"
+                           : "SELECT lsn, xid, encode(data, 'hex') AS data"} +
+        " FROM pg_logical_slot_peek_binary_changes($1, NULL, NULL,"
+        " 'proto_version', '1', 'publication_names', $2)"};
+
+    auto start = std::chrono::steady_clock::now();
+
+    pq::result const result =
+        db->exec_params(select, {slot, publication}, binary);
+
+    run_result r;
+    r.query_ms = ms_since(start);
+    r.rows = result.size();
+
+    start = std::chrono::steady_clock::now();
+
+    pgoutput::log_builder builder;
+    builder.reserve(static_cast<std::size_t>(r.rows) * 50UL);
+
+    int const data_col = binary ? 1 : 2;
+    for (int row = 0; row < r.rows; ++row) {
+        auto const data = result.get(row, data_col);
+        r.result_bytes += data.size();
+        if (binary) {
+            builder.add_message(result.get(row, 0), data);
+        } else {
+            auto const bytes = hex2bytes(data);
+            builder.add_message(result.get(row, 0),
+                                std::string_view{bytes.data(), bytes.size()});
+        }
+    }
+
+    r.decode_ms = ms_since(start);
+    r.log_bytes = builder.data().size();
+
+    return r;
+}
+
+void report(char const *name, run_result const &r)
+{
+    std::cout << name << ": " << r.rows << " rows, query " << r.query_ms
+              << " ms, decode " << r.decode_ms << " ms, data column "
+              << r.result_bytes / 1024 << " kB, log " << r.log_bytes / 1024
+              << " kB\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: bench-get-log-peek CONNINFO [SLOT "
+                     "[PUBLICATION]]\n";
+        return 2;
+    }
+
+    std::string const slot{argc > 2 ? argv[2] : "osmdbt"};
+    std::string const publication{argc > 3 ? argv[3] : "osmdbt_publication"};
+
+    pq::connection db{argv[1]};
+
+    // Alternate the variants, so both see a warm cache
+    for (int i = 0; i < 3; ++i) {
+        report("text (hex)", run(&db, slot, publication, false));
+        report("binary    ", run(&db, slot, publication, true));
+    }
+
+    return 0;
+}
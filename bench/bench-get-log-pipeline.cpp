@@ -0,0 +1,140 @@
+/*
+ * Benchmark for fetching, decoding, and writing a backlog of changes in
+ * osmdbt-get-log: in a single thread, pipelined, and pipelined with
+ * several decoding threads.
+ *
+ * Fetching is simulated by copying batches of 1000 messages (the rows
+ * libpq returns in one piece), optionally waiting some microseconds per
+ * batch for the network. The log is written to a temporary file.
+ *
+ * Usage: bench-get-log-pipeline [NUMBER_OF_CHANGES [FETCH_WAIT_US
+ *                                [DECODE_THREADS]]]
+ */
+
+#include "pipeline.hpp"
+#include "synthetic-changes.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr std::size_t const batch_size = 1000;
+
+constexpr std::size_t const buffer_size = 64UL * 1024UL * 1024UL;
+
+// Batch of messages looking like a pq::result
+class batch
+{
+public:
+    batch() = default;
+
+    batch(std::vector<std::string> const &messages, std::size_t begin,
+          std::size_t end)
+    : m_messages(messages.begin() + static_cast<std::ptrdiff_t>(begin),
+                 messages.begin() + static_cast<std::ptrdiff_t>(end))
+    {
+    }
+
+    explicit operator bool() const noexcept { return !m_messages.empty(); }
+
+    [[nodiscard]] int size() const noexcept
+    {
+        return static_cast<int>(m_messages.size());
+    }
+
+    [[nodiscard]] std::string_view get(int row, int col) const noexcept
+    {
+        if (col == 0) {
+            return "1A/B374D848";
+        }
+        return m_messages[static_cast<std::size_t>(row)];
+    }
+
+private:
+    std::vector<std::string> m_messages;
+};
+
+void run(std::vector<std::string> const &messages,
+         std::chrono::microseconds fetch_wait, bool pipelined,
+         unsigned int decode_threads)
+{
+    std::FILE *file = std::tmpfile();
+    if (!file) {
+        std::cerr << "Can not create temporary file\n";
+        std::exit(1);
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+
+    std::size_t next = 0;
+    std::size_t bytes = 0;
+    auto const result = decode_log(
+        [&] {
+            if (next >= messages.size()) {
+                return batch{};
+            }
+            std::this_thread::sleep_for(fetch_wait);
+            auto const end = std::min(next + batch_size, messages.size());
+            batch b{messages, next, end};
+            next = end;
+            return b;
+        },
+        [&](std::string_view data) {
+            bytes += std::fwrite(data.data(), 1, data.size(), file);
+        },
+        buffer_size, pipelined, decode_threads);
+    std::fflush(file);
+    ::fsync(fileno(file));
+
+    auto const end = std::chrono::steady_clock::now();
+    std::fclose(file);
+
+    auto const ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(end - start)
+            .count();
+
+    if (!pipelined) {
+        std::cout << "single-threaded:     ";
+    } else if (decode_threads == 1) {
+        std::cout << "pipelined:           ";
+    } else {
+        std::cout << "pipelined, " << decode_threads << " threads: ";
+    }
+    std::cout << result.entries << " messages, " << bytes / 1024 / 1024
+              << " MB of log in " << ms << " ms: "
+              << static_cast<double>(result.entries) /
+                     static_cast<double>(std::max<int64_t>(ms, 1)) / 1000.0
+              << " M messages/s\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t const changes =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+    std::chrono::microseconds const fetch_wait{
+        argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 0};
+    auto const decode_threads = static_cast<unsigned int>(
+        argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 4);
+
+    auto const messages = synthetic_changes(changes);
+
+    run(messages, fetch_wait, false, 1);
+    run(messages, fetch_wait, true, 1);
+    run(messages, fetch_wait, true, decode_threads);
+
+    return 0;
+}
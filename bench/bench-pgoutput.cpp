@@ -0,0 +1,47 @@
+/*
+ * Benchmark for decoding pgoutput messages into log lines.
+ *
+ * Usage: bench-pgoutput [NUMBER_OF_CHANGES]
+ */
+
+#include "pgoutput.hpp"
+#include "synthetic-changes.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char *argv[])
+{
+    std::size_t const changes =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    auto const messages = synthetic_changes(changes);
+
+    std::string const lsn{"1A/B374D848"};
+
+    auto const start = std::chrono::steady_clock::now();
+
+    pgoutput::log_builder builder;
+    builder.reserve(changes * 50UL);
+    for (auto const &msg : messages) {
+        builder.add_message(lsn, msg);
+    }
+
+    auto const end = std::chrono::steady_clock::now();
+
+    auto const ns =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count();
+
+    std::cout << "Decoded " << messages.size() << " messages ("
+              << builder.committed_data().size() << " bytes of log) in "
+              << ns / 1000000 << " ms: "
+              << static_cast<double>(ns) / static_cast<double>(messages.size())
+              << " ns/message\n";
+
+    return 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Benchmark comparing how tags get from the tags query into the objects
+ * in osmdbt-create-diff:
+ *
+ * - "std::string tags": all tags of a batch are first copied into a
+ *   vector of structs with two std::string members,
+ * - "tag_store": all tags of a batch are first copied into the tag_store
+ *   with values in one string and interned keys,
+ * - "streaming": the tags are handed from the result to the
+ *   TagListBuilder as string views, without storing them.
+ *
+ * The tags are in a libpq result in binary format like the one the tags
+ * query returns. For each object a node with its tags is built into an
+ * osmium buffer, which is cleared whenever it is filled beyond 1 MB like
+ * the buffers handed to the writer. It measures the time to store the
+ * tags and to build the objects and counts heap allocations.
+ *
+ * Usage: bench-tag-store [NUMBER_OF_TAGS]
+ */
+
+#include "pq.hpp"
+#include "tagstore.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+std::size_t allocations = 0;
+std::size_t allocated_bytes = 0;
+
+} // anonymous namespace
+
+// Count all heap allocations of the program.
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    allocated_bytes += size;
+    if (void *ptr = std::malloc(size)) { // NOLINT(cppcoreguidelines-no-malloc)
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr); // NOLINT(cppcoreguidelines-no-malloc)
+}
+
+namespace {
+
+constexpr std::size_t const flush_size = 1024UL * 1024UL;
+
+// The tag storage used before the tag_store
+struct string_tag
+{
+    std::string key;
+    std::string value;
+    osmium::object_id_type id;
+    osmium::object_version_type version;
+
+    string_tag(osmium::object_id_type id_,
+               osmium::object_version_type version_, std::string_view key_,
+               std::string_view value_)
+    : key(key_), value(value_), id(id_), version(version_)
+    {}
+};
+
+std::string to_binary(std::int64_t value)
+{
+    std::string data(sizeof(value), '\0');
+    auto v = static_cast<std::uint64_t>(value);
+    for (auto it = data.rbegin(); it != data.rend(); ++it) {
+        *it = static_cast<char>(v & 0xffU);
+        v >>= 8U;
+    }
+    return data;
+}
+
+// A result in binary format with the columns of the tags query (id,
+// version, k, v) and a mix of common short and long keys and values.
+pq::result synthetic_tags(std::size_t count)
+{
+    static std::array<char const *, 8> const keys{
+        "highway",          "building",    "name",
+        "addr:housenumber", "addr:street", "source",
+        "surface",          "building:levels"};
+    static std::array<char const *, 8> const values{
+        "residential", "yes", "Hauptstraße", "12a",
+        "Avenue des Champs-Élysées", "Bing aerial imagery", "asphalt", "3"};
+
+    PGresult *result = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+
+    std::array<PGresAttDesc, 4> attrs{{
+        {const_cast<char *>("id"), 0, 0, 1, 20, 8, -1},
+        {const_cast<char *>("version"), 0, 0, 1, 20, 8, -1},
+        {const_cast<char *>("k"), 0, 0, 1, 25, -1, -1},
+        {const_cast<char *>("v"), 0, 0, 1, 25, -1, -1},
+    }};
+    PQsetResultAttrs(result, static_cast<int>(attrs.size()), attrs.data());
+
+    auto const version = to_binary(1);
+    for (std::size_t n = 0; n < count; ++n) {
+        auto const row = static_cast<int>(n);
+        auto const id = to_binary(static_cast<std::int64_t>(n / 4));
+        char const *key = keys[n % keys.size()];
+        char const *value = values[(n / 3) % values.size()];
+        PQsetvalue(result, row, 0, const_cast<char *>(id.data()), 8);
+        PQsetvalue(result, row, 1, const_cast<char *>(version.data()), 8);
+        PQsetvalue(result, row, 2, const_cast<char *>(key),
+                   static_cast<int>(std::string_view{key}.size()));
+        PQsetvalue(result, row, 3, const_cast<char *>(value),
+                   static_cast<int>(std::string_view{value}.size()));
+    }
+
+    return pq::result{result};
+}
+
+std::int64_t get_int64(pq::result const &result, int row, int col)
+{
+    return pq::int64_from_binary(result.get(row, col));
+}
+
+/**
+ * Build nodes from a range of tags sorted by object. The get_* functions
+ * return the id, version, key, and value of the tag at an iterator.
+ */
+template <typename TIterator, typename TId, typename TVersion,
+          typename TKey, typename TValue>
+void build(osmium::memory::Buffer *buffer, TIterator it, TIterator end,
+           TId &&get_id, TVersion &&get_version, TKey &&get_key,
+           TValue &&get_value)
+{
+    while (it != end) {
+        auto const id = get_id(it);
+        auto const version = get_version(it);
+        {
+            osmium::builder::NodeBuilder builder{*buffer};
+            builder.set_id(id).set_version(version);
+            osmium::builder::TagListBuilder tbuilder{builder};
+            do {
+                auto const key = get_key(it);
+                auto const value = get_value(it);
+                tbuilder.add_tag(key.data(), key.size(), value.data(),
+                                 value.size());
+                ++it;
+            } while (it != end && get_id(it) == id &&
+                     get_version(it) == version);
+        }
+        buffer->commit();
+        if (buffer->committed() > flush_size) {
+            buffer->clear();
+        }
+    }
+}
+
+double ms_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void report(char const *name, std::size_t tags, double store_ms,
+            double build_ms, std::size_t allocs, std::size_t bytes)
+{
+    std::cout << name << ": store " << store_ms << " ms, build " << build_ms
+              << " ms ("
+              << (store_ms + build_ms) * 1000000.0 /
+                     static_cast<double>(tags)
+              << " ns/tag), " << allocs << " allocations, " << bytes / 1024
+              << " kB allocated\n";
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+    std::size_t const count =
+        argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    auto const result = synthetic_tags(count);
+    int const rows = result.size();
+
+    osmium::memory::Buffer buffer{2 * flush_size,
+                                  osmium::memory::Buffer::auto_grow::yes};
+
+    {
+        allocations = 0;
+        allocated_bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<string_tag> tags;
+        tags.reserve(count);
+        for (int row = 0; row < rows; ++row) {
+            tags.emplace_back(get_int64(result, row, 0),
+                              static_cast<osmium::object_version_type>(
+                                  get_int64(result, row, 1)),
+                              result.get(row, 2), result.get(row, 3));
+        }
+        auto const store_ms = ms_since(start);
+
+        start = std::chrono::steady_clock::now();
+        build(
+            &buffer, tags.cbegin(), tags.cend(),
+            [](auto it) { return it->id; },
+            [](auto it) { return it->version; },
+            [](auto it) { return std::string_view{it->key}; },
+            [](auto it) { return std::string_view{it->value}; });
+        report("std::string tags", count, store_ms, ms_since(start),
+               allocations, allocated_bytes);
+    }
+
+    buffer.clear();
+
+    {
+        allocations = 0;
+        allocated_bytes = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        tag_store tags;
+        tags.reserve(count);
+        for (int row = 0; row < rows; ++row) {
+            tags.add(get_int64(result, row, 0),
+                     static_cast<osmium::object_version_type>(
+                         get_int64(result, row, 1)),
+                     result.get(row, 2), result.get(row, 3));
+        }
+        auto const store_ms = ms_since(start);
+
+        start = std::chrono::steady_clock::now();
+        build(
+            &buffer, tags.begin(), tags.end(),
+            [](auto it) { return it->id; },
+            [](auto it) { return it->version; },
+            [&](auto it) { return tags.key(*it); },
+            [&](auto it) { return tags.value(*it); });
+        report("tag_store", count, store_ms, ms_since(start), allocations,
+               allocated_bytes);
+    }
+
+    buffer.clear();
+
+    {
+        allocations = 0;
+        allocated_bytes = 0;
+        auto const start = std::chrono::steady_clock::now();
+
+        build(
+            &buffer, 0, rows,
+            [&](int row) { return get_int64(result, row, 0); },
+            [&](int row) {
+                return static_cast<osmium::object_version_type>(
+                    get_int64(result, row, 1));
+            },
+            [&](int row) { return result.get(row, 2); },
+            [&](int row) { return result.get(row, 3); });
+        report("streaming", count, 0.0, ms_since(start), allocations,
+               allocated_bytes);
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+// Synthetic pgoutput messages for the benchmarks
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class message
+{
+public:
+    explicit message(char op) { m_data += op; }
+
+    template <typename T>
+    message &add(T value)
+    {
+        for (unsigned int i = 0; i < sizeof(T); ++i) {
+            m_data += static_cast<char>(
+                (static_cast<uint64_t>(value) >> (8U * (sizeof(T) - i - 1))) &
+                0xffU);
+        }
+        return *this;
+    }
+
+    message &add_string(std::string const &str)
+    {
+        m_data += str;
+        m_data += '\0';
+        return *this;
+    }
+
+    message &add_text_column(std::string const &str)
+    {
+        m_data += 't';
+        add<int32_t>(static_cast<int32_t>(str.size()));
+        m_data += str;
+        return *this;
+    }
+
+    [[nodiscard]] std::string const &data() const noexcept { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+inline std::vector<std::string> const node_columns{
+    "node_id",   "latitude", "longitude", "changeset_id", "visible",
+    "timestamp", "tile",     "version",   "redaction_id"};
+
+inline std::vector<std::string> const way_columns{
+    "way_id", "changeset_id", "timestamp", "version", "visible",
+    "redaction_id"};
+
+inline std::string relation_message(int32_t relation_id,
+                                    std::string const &name,
+                                    std::vector<std::string> const &columns)
+{
+    message msg{'R'};
+    msg.add<int32_t>(relation_id)
+        .add_string("public")
+        .add_string(name)
+        .add<int8_t>('d')
+        .add<int16_t>(static_cast<int16_t>(columns.size()));
+    for (auto const &column : columns) {
+        msg.add<int8_t>(0).add_string(column).add<int32_t>(20).add<int32_t>(
+            -1);
+    }
+    return msg.data();
+}
+
+inline std::string node_insert(int64_t id)
+{
+    message msg{'I'};
+    msg.add<int32_t>(1).add<int8_t>('N').add<int16_t>(9);
+    msg.add_text_column(std::to_string(id))
+        .add_text_column("515000000")
+        .add_text_column("-1000000")
+        .add_text_column("123456789")
+        .add_text_column("t")
+        .add_text_column("2024-01-01 12:34:56")
+        .add_text_column("3221225472")
+        .add_text_column("1");
+    msg.add<int8_t>('n');
+    return msg.data();
+}
+
+inline std::string way_insert(int64_t id)
+{
+    message msg{'I'};
+    msg.add<int32_t>(2).add<int8_t>('N').add<int16_t>(6);
+    msg.add_text_column(std::to_string(id))
+        .add_text_column("123456789")
+        .add_text_column("2024-01-01 12:34:56")
+        .add_text_column("2")
+        .add_text_column("t");
+    msg.add<int8_t>('n');
+    return msg.data();
+}
+
+inline std::string begin_message(uint32_t xid)
+{
+    return message{'B'}
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .add<uint32_t>(xid)
+        .data();
+}
+
+inline std::string commit_message()
+{
+    return message{'C'}
+        .add<int8_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .data();
+}
+
+/**
+ * Messages for the given number of changes in transactions with 1000
+ * changes each, 9 of 10 are nodes.
+ */
+inline std::vector<std::string> synthetic_changes(std::size_t changes)
+{
+    std::vector<std::string> messages;
+    messages.reserve(changes + changes / 1000 * 2 + 4);
+    messages.push_back(begin_message(1));
+    messages.push_back(relation_message(1, "nodes", node_columns));
+    messages.push_back(relation_message(2, "ways", way_columns));
+    for (std::size_t i = 0; i < changes; ++i) {
+        auto const id = static_cast<int64_t>(10000000000 + i);
+        messages.push_back(i % 10 == 9 ? way_insert(id) : node_insert(id));
+        if (i % 1000 == 999) {
+            messages.push_back(commit_message());
+            messages.push_back(begin_message(static_cast<uint32_t>(i)));
+        }
+    }
+    messages.push_back(commit_message());
+    return messages;
+}
@@ -0,0 +1,66 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+// pg_logical_slot_peek_changes() takes the number of changes as int
+constexpr double const max_changes = std::numeric_limits<int32_t>::max();
+
+// Measured values are averaged with the previous ones, so a single slow
+// or fast batch doesn't change the batch size too much.
+double smooth(double old_value, double new_value) noexcept
+{
+    return old_value == 0.0 ? new_value : (old_value + new_value) / 2.0;
+}
+
+} // anonymous namespace
+
+batch_sizer::batch_sizer(seconds target_time, std::size_t max_bytes,
+                         uint32_t initial_changes) noexcept
+: m_target_time(target_time), m_max_bytes(max_bytes),
+  m_last_changes(std::max(initial_changes, min_changes))
+{
+}
+
+uint32_t batch_sizer::next(seconds remaining) const noexcept
+{
+    if (m_rate == 0.0) {
+        return m_last_changes;
+    }
+
+    double changes = m_rate * std::min(m_target_time, remaining).count();
+
+    if (m_bytes_per_change > 0.0) {
+        changes = std::min(changes, static_cast<double>(m_max_bytes) /
+                                        m_bytes_per_change);
+    }
+
+    changes = std::min(changes, static_cast<double>(m_last_changes) *
+                                    static_cast<double>(max_growth));
+    changes = std::clamp(changes, static_cast<double>(min_changes),
+                         max_changes);
+
+    return static_cast<uint32_t>(changes);
+}
+
+void batch_sizer::update(std::size_t changes, std::size_t bytes,
+                         seconds elapsed) noexcept
+{
+    if (changes == 0) {
+        return;
+    }
+
+    // Avoid absurd rates from batches that were too quick to measure
+    auto const time = std::max(elapsed.count(), 0.001);
+
+    m_rate = smooth(m_rate, static_cast<double>(changes) / time);
+    m_bytes_per_change = smooth(m_bytes_per_change,
+                                static_cast<double>(bytes) /
+                                    static_cast<double>(changes));
+    m_last_changes = static_cast<uint32_t>(
+        std::clamp(static_cast<double>(changes),
+                   static_cast<double>(min_changes), max_changes));
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Chooses the number of changes to read from the replication slot in one
+ * batch. The number is adjusted after every batch from the measured rate
+ * (changes per second from peeking to writing the log file) and the size
+ * of the log data per change, so that a batch takes about the target time
+ * and its log data doesn't grow beyond the memory budget.
+ */
+class batch_sizer
+{
+public:
+    using seconds = std::chrono::duration<double>;
+
+    /// Batches are never smaller than this.
+    static constexpr uint32_t const min_changes = 1000;
+
+    /// A batch is at most this many times larger than the one before.
+    static constexpr uint32_t const max_growth = 4;
+
+    batch_sizer(seconds target_time, std::size_t max_bytes,
+                uint32_t initial_changes) noexcept;
+
+    /**
+     * Number of changes for the next batch, taking into account how much
+     * time is left.
+     */
+    [[nodiscard]] uint32_t next(seconds remaining) const noexcept;
+
+    /// Record the results of a batch.
+    void update(std::size_t changes, std::size_t bytes,
+                seconds elapsed) noexcept;
+
+    /// Measured changes per second (0 before the first update).
+    [[nodiscard]] double rate() const noexcept { return m_rate; }
+
+    /// Measured bytes of log data per change (0 before the first update).
+    [[nodiscard]] double bytes_per_change() const noexcept
+    {
+        return m_bytes_per_change;
+    }
+
+private:
+    seconds m_target_time;
+    std::size_t m_max_bytes;
+    uint32_t m_last_changes;
+    double m_rate = 0.0;
+    double m_bytes_per_change = 0.0;
+
+}; // class batch_sizer
@@ -0,0 +1,341 @@
+#include "binlog.hpp"
+
+#include "lsn.hpp"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace blog {
+
+namespace {
+
+constexpr char const file_magic[8] = {'O', 'S', 'M', 'D', 'B', 'T', 'B', 'L'};
+constexpr char const trailer_magic[4] = {'B', 'E', 'N', 'D'};
+constexpr uint32_t const byte_order_mark = 0x01020304;
+constexpr uint32_t const format_version = 2;
+
+uint32_t crc32_update(uint32_t crc, std::string_view data) noexcept
+{
+    // zlib takes the length as uInt, so feed large buffers in pieces
+    constexpr std::size_t const max_piece = 1024UL * 1024UL * 1024UL;
+    while (!data.empty()) {
+        auto const size = std::min(data.size(), max_piece);
+        crc = ::crc32(crc, reinterpret_cast<Bytef const *>(data.data()),
+                      static_cast<uInt>(size));
+        data.remove_prefix(size);
+    }
+    return crc;
+}
+
+template <typename T>
+bool parse_number(std::string_view str, T *value, int base = 10) noexcept
+{
+    auto const [ptr, ec] =
+        std::from_chars(str.data(), str.data() + str.size(), *value, base);
+    return ec == std::errc{} && ptr == str.data() + str.size();
+}
+
+// Parse LSN in the usual text form "1A/B374D848".
+bool parse_lsn(std::string_view str, uint64_t *lsn) noexcept
+{
+    auto const pos = str.find('/');
+    if (pos == std::string_view::npos) {
+        return false;
+    }
+
+    uint64_t upper = 0;
+    uint64_t lower = 0;
+    if (!parse_number(str.substr(0, pos), &upper, 16) ||
+        !parse_number(str.substr(pos + 1), &lower, 16)) {
+        return false;
+    }
+
+    *lsn = (upper << 32U) + lower;
+    return true;
+}
+
+// Parse the number after the prefix character (like the 'v' in "v3").
+template <typename T>
+bool parse_prefixed(std::string_view str, char prefix, T *value) noexcept
+{
+    if (str.size() < 2 || str[0] != prefix) {
+        return false;
+    }
+    return parse_number(str.substr(1), value);
+}
+
+bool is_object_type(char type) noexcept
+{
+    return type == 'n' || type == 'w' || type == 'r';
+}
+
+// Fill in the record from the fields of a text log line, returns false if
+// the line has the wrong format.
+bool parse_line(std::string_view line, record *rec) noexcept
+{
+    std::string_view parts[7];
+    std::size_t count = 0;
+    bool more_parts = false; // only allowed in error lines
+    while (!line.empty()) {
+        if (count == std::size(parts)) {
+            more_parts = true;
+            break;
+        }
+        auto const pos = line.find(' ');
+        parts[count++] = line.substr(0, pos);
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        line.remove_prefix(pos + 1);
+    }
+
+    if (count < 3 || parts[2].size() != 1 || !parse_lsn(parts[0], &rec->lsn) ||
+        !parse_number(parts[1], &rec->xid)) {
+        return false;
+    }
+
+    rec->op = parts[2][0];
+    if (rec->op == 'X') {
+        return true;
+    }
+    if (more_parts) {
+        return false;
+    }
+    if (rec->op == 'C') {
+        return count == 3;
+    }
+
+    if (!((rec->op == 'N' && count == 6) || (rec->op == 'R' && count == 7)) ||
+        parts[3].empty() || !is_object_type(parts[3][0])) {
+        return false;
+    }
+
+    rec->type = parts[3][0];
+    if (!parse_number(parts[3].substr(1), &rec->id) ||
+        !parse_prefixed(parts[4], 'v', &rec->version) ||
+        !parse_prefixed(parts[5], 'c', &rec->changeset)) {
+        return false;
+    }
+
+    if (rec->op == 'R') {
+        if (parts[6] == "NULL") {
+            rec->redaction = no_redaction;
+            return true;
+        }
+        return parse_number(parts[6], &rec->redaction) && rec->redaction >= 0;
+    }
+
+    return true;
+}
+
+} // anonymous namespace
+
+bool is_binary_log_name(std::string_view file_name) noexcept
+{
+    std::string_view const done{".done"};
+    if (file_name.size() > done.size() &&
+        file_name.substr(file_name.size() - done.size()) == done) {
+        file_name.remove_suffix(done.size());
+    }
+
+    std::string_view const ext{extension};
+    return file_name.size() > ext.size() &&
+           file_name.substr(file_name.size() - ext.size()) == ext;
+}
+
+std::string file_header()
+{
+    header h{};
+    std::memcpy(h.magic, file_magic, sizeof(h.magic));
+    h.byte_order = byte_order_mark;
+    h.version = format_version;
+    h.record_size = sizeof(record);
+
+    return std::string(reinterpret_cast<char const *>(&h), sizeof(header));
+}
+
+void checksum::update(std::string_view records) noexcept
+{
+    m_size += records.size();
+    m_crc = crc32_update(m_crc, records);
+}
+
+std::string checksum::file_trailer() const
+{
+    trailer t{};
+    t.records = m_size / sizeof(record);
+    t.checksum = m_crc;
+    std::memcpy(t.magic, trailer_magic, sizeof(t.magic));
+
+    return std::string(reinterpret_cast<char const *>(&t), sizeof(trailer));
+}
+
+std::string file_data(std::string_view records)
+{
+    checksum sum;
+    sum.update(records);
+
+    std::string data{file_header()};
+    data.append(records);
+    data.append(sum.file_trailer());
+
+    return data;
+}
+
+void append_text(std::string *out, record const &rec)
+{
+    out->append(lsn_type{rec.lsn}.str());
+    *out += ' ';
+    out->append(std::to_string(rec.xid));
+    *out += ' ';
+    *out += rec.op;
+
+    if (rec.op == 'N' || rec.op == 'R') {
+        *out += ' ';
+        *out += rec.type;
+        out->append(std::to_string(rec.id));
+        *out += " v";
+        out->append(std::to_string(rec.version));
+        *out += " c";
+        out->append(std::to_string(rec.changeset));
+    }
+
+    if (rec.op == 'R') {
+        *out += ' ';
+        if (rec.redaction == no_redaction) {
+            out->append("NULL");
+        } else {
+            out->append(std::to_string(rec.redaction));
+        }
+    }
+
+    *out += '\n';
+}
+
+std::string text_to_records(std::string_view text)
+{
+    std::string records;
+    records.reserve(text.size());
+
+    for (std::size_t line_number = 1; !text.empty(); ++line_number) {
+        auto const pos = text.find('\n');
+        auto const line = text.substr(0, pos);
+        record rec{};
+        if (!parse_line(line, &rec)) {
+            throw std::runtime_error{"Log line " + std::to_string(line_number) +
+                                     " has wrong format: " +
+                                     std::string{line}};
+        }
+        append(&records, rec);
+        if (pos == std::string_view::npos) {
+            break;
+        }
+        text.remove_prefix(pos + 1);
+    }
+
+    return records;
+}
+
+mapped_file::mapped_file(std::string const &file_name)
+{
+    int const fd = ::open(file_name.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+    if (fd < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not open log file '" + file_name +
+                                    "'"};
+    }
+
+    struct stat st = {};
+    if (::fstat(fd, &st) != 0) {
+        int const err = errno;
+        ::close(fd);
+        throw std::system_error{err, std::system_category(),
+                                "Could not stat log file '" + file_name + "'"};
+    }
+    m_file_size = static_cast<std::size_t>(st.st_size);
+
+    if (m_file_size < sizeof(header) + sizeof(trailer)) {
+        ::close(fd);
+        throw std::runtime_error{"Binary log file '" + file_name +
+                                 "' is truncated"};
+    }
+
+    void *data = ::mmap(nullptr, m_file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int const err = errno;
+    ::close(fd);
+    if (data == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+        throw std::system_error{err, std::system_category(),
+                                "Could not map log file '" + file_name + "'"};
+    }
+    m_data = static_cast<char const *>(data);
+
+    try {
+        header h{};
+        std::memcpy(&h, m_data, sizeof(header));
+        if (std::memcmp(h.magic, file_magic, sizeof(h.magic)) != 0) {
+            throw std::runtime_error{"File '" + file_name +
+                                     "' is not a binary log file"};
+        }
+        if (h.byte_order != byte_order_mark) {
+            throw std::runtime_error{"Binary log file '" + file_name +
+                                     "' was written on a machine with "
+                                     "different byte order"};
+        }
+        if (h.version != format_version || h.record_size != sizeof(record)) {
+            throw std::runtime_error{"Binary log file '" + file_name +
+                                     "' has unsupported format version"};
+        }
+
+        std::size_t const records_size =
+            m_file_size - sizeof(header) - sizeof(trailer);
+        trailer t{};
+        std::memcpy(&t, m_data + sizeof(header) + records_size,
+                    sizeof(trailer));
+        if (std::memcmp(t.magic, trailer_magic, sizeof(t.magic)) != 0 ||
+            records_size % sizeof(record) != 0 ||
+            t.records != records_size / sizeof(record)) {
+            throw std::runtime_error{"Binary log file '" + file_name +
+                                     "' is truncated"};
+        }
+
+        std::string_view const records{m_data + sizeof(header),
+                                       records_size};
+        if (crc32_update(0, records) != t.checksum) {
+            throw std::runtime_error{"Binary log file '" + file_name +
+                                     "' has wrong checksum"};
+        }
+        m_records = t.records;
+    } catch (...) {
+        ::munmap(const_cast<char *>(m_data), m_file_size);
+        throw;
+    }
+}
+
+mapped_file::~mapped_file() noexcept
+{
+    ::munmap(const_cast<char *>(m_data), m_file_size);
+}
+
+record mapped_file::get(std::size_t n) const noexcept
+{
+    record rec{};
+    std::memcpy(&rec, m_data + sizeof(header) + n * sizeof(record),
+                sizeof(record));
+    return rec;
+}
+
+} // namespace blog
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * Binary log format (.blog files)
+ *
+ * An alternative to the text log format which can be read without any
+ * parsing. The file consists of a header, any number of fixed-size
+ * records, and a trailer with the number of records and a CRC32 checksum
+ * of all records. Numbers are in host byte order; the header contains a
+ * byte order mark so files from other architectures are detected.
+ */
+namespace blog {
+
+constexpr char const *const extension = ".blog";
+
+/**
+ * Is this the name of a binary log file? These have the extension ".blog",
+ * optionally followed by ".done" after they have been processed.
+ */
+[[nodiscard]] bool is_binary_log_name(std::string_view file_name) noexcept;
+
+struct header
+{
+    char magic[8]; // "OSMDBTBL"
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+/// Redaction id of 'R' records for NULL.
+constexpr int32_t const no_redaction = -1;
+
+/**
+ * One line of the log. Op is 'N' (new object), 'R' (redaction, with the
+ * redaction id or no_redaction for NULL), 'C' (commit, only lsn and xid
+ * are set), or 'X' (error, only lsn and xid are set, the error message of
+ * the text format is not kept).
+ */
+struct record
+{
+    uint64_t lsn;
+    uint32_t xid;
+    char op;
+    char type; // 'n', 'w', or 'r'
+    uint16_t reserved;
+    int64_t id;
+    uint32_t version;
+    int32_t redaction;
+    int64_t changeset;
+};
+
+struct trailer
+{
+    uint64_t records;
+    uint32_t checksum;
+    char magic[4]; // "BEND"
+};
+
+static_assert(sizeof(header) == 24, "unexpected padding in blog::header");
+static_assert(sizeof(record) == 40, "unexpected padding in blog::record");
+static_assert(sizeof(trailer) == 16, "unexpected padding in blog::trailer");
+
+/// Append the bytes of the record to out.
+inline void append(std::string *out, record const &rec)
+{
+    out->append(reinterpret_cast<char const *>(&rec), sizeof(record));
+}
+
+/// The header for a new file.
+[[nodiscard]] std::string file_header();
+
+/**
+ * Keeps track of the records written to a file for the trailer.
+ */
+class checksum
+{
+public:
+    void update(std::string_view records) noexcept;
+
+    /// The trailer for all records seen by update().
+    [[nodiscard]] std::string file_trailer() const;
+
+private:
+    uint64_t m_size = 0;
+    uint32_t m_crc = 0;
+
+}; // class checksum
+
+/// Header, records, and trailer of a complete file.
+[[nodiscard]] std::string file_data(std::string_view records);
+
+/**
+ * Append a log line in text format for the record to out.
+ */
+void append_text(std::string *out, record const &rec);
+
+/**
+ * Convert log lines in text format to records.
+ *
+ * @throws std::runtime_error if a line has the wrong format.
+ */
+[[nodiscard]] std::string text_to_records(std::string_view text);
+
+/**
+ * A binary log file mapped into memory. The header and trailer are
+ * checked when it is opened.
+ */
+class mapped_file
+{
+public:
+    explicit mapped_file(std::string const &file_name);
+
+    mapped_file(mapped_file const &) = delete;
+    mapped_file(mapped_file &&) = delete;
+
+    mapped_file &operator=(mapped_file const &) = delete;
+    mapped_file &operator=(mapped_file &&) = delete;
+
+    ~mapped_file() noexcept;
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_records; }
+
+    /// Get record n. The data is copied, because it might not be aligned.
+    [[nodiscard]] record get(std::size_t n) const noexcept;
+
+private:
+    char const *m_data = nullptr;
+    std::size_t m_file_size = 0;
+    std::size_t m_records = 0;
+
+}; // class mapped_file
+
+} // namespace blog
@@ -0,0 +1,385 @@
+#include "compression.hpp"
+
+#include <zlib.h>
+
+#ifdef OSMDBT_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Size of pieces of compressed and uncompressed data handled at once
+constexpr std::size_t const chunk_size = 64UL * 1024UL;
+
+// zlib takes sizes as uInt, so larger buffers are handled in pieces
+constexpr std::size_t const max_piece_size = 1024UL * 1024UL * 1024UL;
+
+bool ends_with(std::string_view str, std::string_view suffix) noexcept
+{
+    return str.size() > suffix.size() &&
+           str.substr(str.size() - suffix.size()) == suffix;
+}
+
+[[noreturn]] void no_zstd()
+{
+    throw std::runtime_error{"osmdbt was compiled without zstd support"};
+}
+
+} // anonymous namespace
+
+bool compression_available(compression_type type) noexcept
+{
+#ifdef OSMDBT_WITH_ZSTD
+    (void)type;
+    return true;
+#else
+    return type != compression_type::zstd;
+#endif
+}
+
+char const *compression_suffix(compression_type type) noexcept
+{
+    switch (type) {
+    case compression_type::gzip:
+        return ".gz";
+    case compression_type::zstd:
+        return ".zst";
+    default:
+        break;
+    }
+    return "";
+}
+
+compression_type compression_of_file(std::string_view file_name) noexcept
+{
+    if (ends_with(file_name, ".done")) {
+        file_name.remove_suffix(5);
+    }
+
+    if (ends_with(file_name, ".gz")) {
+        return compression_type::gzip;
+    }
+    if (ends_with(file_name, ".zst")) {
+        return compression_type::zstd;
+    }
+    return compression_type::none;
+}
+
+compressor::compressor(compression_type type) : m_type(type)
+{
+    if (type == compression_type::gzip) {
+        m_zstream = std::make_unique<z_stream_s>();
+        // 15 window bits plus 16 for a gzip header and trailer
+        if (deflateInit2(m_zstream.get(), Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                         15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            throw std::runtime_error{"Could not initialize gzip compression"};
+        }
+    } else if (type == compression_type::zstd) {
+#ifdef OSMDBT_WITH_ZSTD
+        m_zstd = ZSTD_createCCtx();
+        if (!m_zstd) {
+            throw std::runtime_error{"Could not initialize zstd compression"};
+        }
+#else
+        no_zstd();
+#endif
+    }
+}
+
+compressor::~compressor() noexcept
+{
+    if (m_zstream) {
+        deflateEnd(m_zstream.get());
+    }
+#ifdef OSMDBT_WITH_ZSTD
+    ZSTD_freeCCtx(m_zstd);
+#endif
+}
+
+std::string compressor::compress(std::string_view data)
+{
+    if (m_type == compression_type::none) {
+        return std::string{data};
+    }
+
+    std::string out;
+    do {
+        auto const size = std::min(data.size(), max_piece_size);
+        run(data.substr(0, size), false, &out);
+        data.remove_prefix(size);
+    } while (!data.empty());
+
+    return out;
+}
+
+std::string compressor::finish()
+{
+    if (m_type == compression_type::none) {
+        return {};
+    }
+    std::string out;
+    run({}, true, &out);
+    return out;
+}
+
+void compressor::run(std::string_view data, bool finish, std::string *out)
+{
+    if (m_type == compression_type::gzip) {
+        auto *zs = m_zstream.get();
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+        zs->next_in = const_cast<Bytef *>(
+            reinterpret_cast<Bytef const *>(data.data()));
+        zs->avail_in = static_cast<uInt>(data.size());
+        for (;;) {
+            auto const old_size = out->size();
+            out->resize(old_size + chunk_size);
+            zs->next_out = reinterpret_cast<Bytef *>(&(*out)[old_size]);
+            zs->avail_out = static_cast<uInt>(chunk_size);
+            auto const ret = deflate(zs, finish ? Z_FINISH : Z_NO_FLUSH);
+            if (ret == Z_STREAM_ERROR) {
+                throw std::runtime_error{"gzip compression failed"};
+            }
+            out->resize(old_size + chunk_size - zs->avail_out);
+            if (finish ? ret == Z_STREAM_END
+                       : (zs->avail_in == 0 && zs->avail_out != 0)) {
+                break;
+            }
+        }
+        return;
+    }
+
+#ifdef OSMDBT_WITH_ZSTD
+    ZSTD_inBuffer input{data.data(), data.size(), 0};
+    for (;;) {
+        auto const old_size = out->size();
+        out->resize(old_size + chunk_size);
+        ZSTD_outBuffer output{&(*out)[old_size], chunk_size, 0};
+        auto const ret = ZSTD_compressStream2(
+            m_zstd, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+        if (ZSTD_isError(ret)) {
+            throw std::runtime_error{std::string{"zstd compression failed: "} +
+                                     ZSTD_getErrorName(ret)};
+        }
+        out->resize(old_size + output.pos);
+        if (finish ? ret == 0 : input.pos == input.size) {
+            break;
+        }
+    }
+#else
+    no_zstd();
+#endif
+}
+
+line_reader::line_reader(std::string file_name)
+: m_file_name(std::move(file_name)), m_type(compression_of_file(m_file_name))
+{
+    if (m_type == compression_type::zstd &&
+        !compression_available(m_type)) {
+        no_zstd();
+    }
+
+    m_fd = ::open(m_file_name.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT
+    if (m_fd < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not open log file '" + m_file_name +
+                                    "'"};
+    }
+
+    bool ok = true;
+    if (m_type == compression_type::gzip) {
+        m_zstream = std::make_unique<z_stream_s>();
+        // 15 window bits plus 16 to only accept gzip format
+        ok = inflateInit2(m_zstream.get(), 15 + 16) == Z_OK;
+        if (!ok) {
+            m_zstream.reset();
+        }
+    }
+#ifdef OSMDBT_WITH_ZSTD
+    if (m_type == compression_type::zstd) {
+        m_zstd = ZSTD_createDCtx();
+        ok = m_zstd != nullptr;
+    }
+#endif
+
+    if (!ok) {
+        ::close(m_fd);
+        throw std::runtime_error{"Could not initialize decompression"};
+    }
+}
+
+line_reader::~line_reader() noexcept
+{
+    ::close(m_fd);
+    if (m_zstream) {
+        inflateEnd(m_zstream.get());
+    }
+#ifdef OSMDBT_WITH_ZSTD
+    ZSTD_freeDCtx(m_zstd);
+#endif
+}
+
+void line_reader::fill_input()
+{
+    m_input.resize(chunk_size);
+    m_input_pos = 0;
+
+    ssize_t n = 0;
+    do {
+        n = ::read(m_fd, m_input.data(), m_input.size());
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not read log file '" + m_file_name +
+                                    "'"};
+    }
+
+    m_input.resize(static_cast<std::size_t>(n));
+    m_eof = (n == 0);
+}
+
+std::size_t line_reader::read(char *buffer, std::size_t size)
+{
+    switch (m_type) {
+    case compression_type::gzip:
+        return read_gzip(buffer, size);
+    case compression_type::zstd:
+        return read_zstd(buffer, size);
+    default:
+        break;
+    }
+
+    if (m_input_pos == m_input.size() && !m_eof) {
+        fill_input();
+    }
+    auto const length = std::min(size, m_input.size() - m_input_pos);
+    std::copy_n(m_input.data() + m_input_pos, length, buffer);
+    m_input_pos += length;
+    return length;
+}
+
+std::size_t line_reader::read_gzip(char *buffer, std::size_t size)
+{
+    auto *zs = m_zstream.get();
+
+    for (;;) {
+        if (m_input_pos == m_input.size() && !m_eof) {
+            fill_input();
+        }
+
+        if (m_stream_end) {
+            if (m_input_pos == m_input.size()) {
+                return 0;
+            }
+            // Another gzip stream follows (or this is the first one)
+            inflateReset(zs);
+            m_stream_end = false;
+        }
+
+        auto const avail_in = m_input.size() - m_input_pos;
+        zs->next_in = reinterpret_cast<Bytef *>(m_input.data() + m_input_pos);
+        zs->avail_in = static_cast<uInt>(avail_in);
+        zs->next_out = reinterpret_cast<Bytef *>(buffer);
+        zs->avail_out = static_cast<uInt>(size);
+
+        auto const ret = inflate(zs, Z_NO_FLUSH);
+        m_input_pos += avail_in - zs->avail_in;
+        auto const length = size - zs->avail_out;
+
+        if (ret == Z_STREAM_END) {
+            m_stream_end = true;
+        } else if (ret == Z_BUF_ERROR && m_eof && length == 0) {
+            throw std::runtime_error{"Log file '" + m_file_name +
+                                     "' is truncated"};
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            throw std::runtime_error{"Error decompressing log file '" +
+                                     m_file_name + "'"};
+        }
+
+        if (length > 0) {
+            return length;
+        }
+    }
+}
+
+std::size_t line_reader::read_zstd(char *buffer, std::size_t size)
+{
+#ifdef OSMDBT_WITH_ZSTD
+    for (;;) {
+        if (m_input_pos == m_input.size() && !m_eof) {
+            fill_input();
+        }
+
+        ZSTD_inBuffer input{m_input.data(), m_input.size(), m_input_pos};
+        ZSTD_outBuffer output{buffer, size, 0};
+        auto const ret = ZSTD_decompressStream(m_zstd, &output, &input);
+        if (ZSTD_isError(ret)) {
+            throw std::runtime_error{"Error decompressing log file '" +
+                                     m_file_name +
+                                     "': " + ZSTD_getErrorName(ret)};
+        }
+
+        bool const progress = input.pos != m_input_pos || output.pos > 0;
+        m_input_pos = input.pos;
+        if (progress) {
+            m_stream_end = (ret == 0);
+        }
+
+        if (output.pos > 0) {
+            return output.pos;
+        }
+        if (!progress && m_eof) {
+            if (!m_stream_end) {
+                throw std::runtime_error{"Log file '" + m_file_name +
+                                         "' is truncated"};
+            }
+            return 0;
+        }
+    }
+#else
+    (void)buffer;
+    (void)size;
+    no_zstd();
+#endif
+}
+
+bool line_reader::getline(std::string *line)
+{
+    for (;;) {
+        auto const pos = m_buffer.find('\n', m_buffer_pos);
+        if (pos != std::string::npos) {
+            line->assign(m_buffer, m_buffer_pos, pos - m_buffer_pos);
+            m_buffer_pos = pos + 1;
+            return true;
+        }
+
+        m_buffer.erase(0, m_buffer_pos);
+        m_buffer_pos = 0;
+
+        auto const old_size = m_buffer.size();
+        m_buffer.resize(old_size + chunk_size);
+        auto const length = read(&m_buffer[old_size], chunk_size);
+        m_buffer.resize(old_size + length);
+
+        if (length == 0) {
+            if (m_buffer.empty()) {
+                return false;
+            }
+            // Last line without newline
+            line->swap(m_buffer);
+            m_buffer.clear();
+            return true;
+        }
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+struct z_stream_s;
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+/**
+ * Compression of log files. Compressed log files get an additional suffix
+ * (".gz" or ".zst"). Support for zstd is only available if osmdbt was
+ * compiled with it (OSMDBT_WITH_ZSTD).
+ */
+enum class compression_type
+{
+    none,
+    gzip,
+    zstd
+};
+
+/// Was osmdbt compiled with support for this compression type?
+[[nodiscard]] bool compression_available(compression_type type) noexcept;
+
+/// Suffix of file names for this compression type ("", ".gz", or ".zst").
+[[nodiscard]] char const *compression_suffix(compression_type type) noexcept;
+
+/**
+ * Compression type of a file judging by its name. A ".done" suffix added
+ * to processed log files is ignored.
+ */
+[[nodiscard]] compression_type
+compression_of_file(std::string_view file_name) noexcept;
+
+/**
+ * Compresses data in pieces into one stream. With compression_type::none
+ * the data is passed through unchanged, but copied. Callers can check
+ * type() and write the data directly in that case.
+ */
+class compressor
+{
+public:
+    explicit compressor(compression_type type);
+
+    compressor(compressor const &) = delete;
+    compressor(compressor &&) = delete;
+
+    compressor &operator=(compressor const &) = delete;
+    compressor &operator=(compressor &&) = delete;
+
+    ~compressor() noexcept;
+
+    [[nodiscard]] compression_type type() const noexcept { return m_type; }
+
+    /**
+     * Add data to the stream. Returns the compressed data which is ready
+     * to be written, this might be empty.
+     */
+    [[nodiscard]] std::string compress(std::string_view data);
+
+    /// End the stream and return the rest of the compressed data.
+    [[nodiscard]] std::string finish();
+
+private:
+    // Compress data appending the output to out
+    void run(std::string_view data, bool finish, std::string *out);
+
+    compression_type m_type;
+    std::unique_ptr<z_stream_s> m_zstream;
+    ZSTD_CCtx_s *m_zstd = nullptr;
+
+}; // class compressor
+
+/**
+ * Reads a (log) file line by line, decompressing it on the fly if its
+ * name says it is compressed.
+ */
+class line_reader
+{
+public:
+    explicit line_reader(std::string file_name);
+
+    line_reader(line_reader const &) = delete;
+    line_reader(line_reader &&) = delete;
+
+    line_reader &operator=(line_reader const &) = delete;
+    line_reader &operator=(line_reader &&) = delete;
+
+    ~line_reader() noexcept;
+
+    /**
+     * Get the next line without the newline character.
+     *
+     * @returns false at the end of the file.
+     */
+    bool getline(std::string *line);
+
+private:
+    std::size_t read(char *buffer, std::size_t size);
+
+    std::size_t read_gzip(char *buffer, std::size_t size);
+
+    std::size_t read_zstd(char *buffer, std::size_t size);
+
+    void fill_input();
+
+    std::string m_file_name;
+    compression_type m_type;
+    int m_fd = -1;
+
+    // Compressed data read from the file
+    std::string m_input;
+    std::size_t m_input_pos = 0;
+    bool m_eof = false;
+
+    // Set between two compressed streams (or frames), ie at the start, at
+    // the end, or if several streams were concatenated
+    bool m_stream_end = true;
+
+    std::unique_ptr<z_stream_s> m_zstream;
+    ZSTD_DCtx_s *m_zstd = nullptr;
+
+    // Uncompressed data not returned by getline() yet
+    std::string m_buffer;
+    std::size_t m_buffer_pos = 0;
+
+}; // class line_reader
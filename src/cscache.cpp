@@ -0,0 +1,206 @@
+#include "cscache.hpp"
+
+#include "io.hpp"
+
+#include <osmium/io/detail/read_write.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr char const file_magic[8] = {'O', 'S', 'M', 'D', 'B', 'T', 'C', 'U'};
+constexpr uint32_t const byte_order_mark = 0x01020304;
+constexpr uint32_t const format_version = 1;
+
+struct file_header
+{
+    char magic[8]; // "OSMDBTCU"
+    uint32_t byte_order;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+struct file_record
+{
+    uint64_t cid;
+    uint64_t name_offset; // relative to the start of the names
+    uint32_t uid;
+    uint32_t name_size;
+};
+
+static_assert(sizeof(file_header) == 32, "unexpected padding in file_header");
+static_assert(sizeof(file_record) == 24, "unexpected padding in file_record");
+
+template <typename T>
+T read_at(std::string const &data, std::size_t offset) noexcept
+{
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+} // anonymous namespace
+
+changeset_cache::changeset_cache(std::string const &filename)
+{
+    if (!std::filesystem::exists(filename)) {
+        return;
+    }
+
+    std::ifstream file{filename, std::ios::binary};
+    if (!file) {
+        throw std::runtime_error{"Can not open changeset cache '" + filename +
+                                 "'"};
+    }
+
+    std::string data{std::istreambuf_iterator<char>{file},
+                     std::istreambuf_iterator<char>{}};
+    if (file.bad()) {
+        throw std::runtime_error{"Error reading changeset cache '" +
+                                 filename + "'"};
+    }
+
+    if (data.size() < sizeof(file_header)) {
+        throw std::runtime_error{"Changeset cache '" + filename +
+                                 "' is too short"};
+    }
+
+    auto const header = read_at<file_header>(data, 0);
+    if (std::memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 ||
+        header.byte_order != byte_order_mark ||
+        header.version != format_version ||
+        header.record_size != sizeof(file_record)) {
+        throw std::runtime_error{"Changeset cache '" + filename +
+                                 "' has an unknown format"};
+    }
+
+    auto const names_offset =
+        sizeof(file_header) + header.count * sizeof(file_record);
+    if (header.count > data.size() / sizeof(file_record) ||
+        data.size() < names_offset) {
+        throw std::runtime_error{"Changeset cache '" + filename +
+                                 "' is truncated"};
+    }
+
+    for (std::size_t n = 0; n < header.count; ++n) {
+        auto const record = read_at<file_record>(
+            data, sizeof(file_header) + n * sizeof(file_record));
+        if (record.name_offset + record.name_size >
+            data.size() - names_offset) {
+            throw std::runtime_error{"Changeset cache '" + filename +
+                                     "' is truncated"};
+        }
+    }
+
+    m_data = std::move(data);
+    m_count = header.count;
+}
+
+bool changeset_cache::find(osmium::changeset_id_type cid,
+                           userinfo *user) const
+{
+    auto const record_at = [this](std::size_t n) {
+        return read_at<file_record>(m_data, sizeof(file_header) +
+                                                n * sizeof(file_record));
+    };
+
+    std::size_t first = 0;
+    std::size_t last = m_count;
+    while (first < last) {
+        auto const middle = first + (last - first) / 2;
+        auto const record = record_at(middle);
+        if (record.cid < cid) {
+            first = middle + 1;
+        } else if (record.cid > cid) {
+            last = middle;
+        } else {
+            auto const names_offset =
+                sizeof(file_header) + m_count * sizeof(file_record);
+            user->id = record.uid;
+            user->username.assign(m_data, names_offset + record.name_offset,
+                                  record.name_size);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void changeset_cache::write(std::string const &filename,
+                            changeset_user_lookup const &lookup)
+{
+    std::vector<std::pair<osmium::changeset_id_type,
+                          changeset_user_lookup::user>>
+        changesets;
+    changesets.reserve(lookup.size());
+    lookup.for_each([&](osmium::changeset_id_type cid,
+                        changeset_user_lookup::user const &user) {
+        if (user.id != 0) {
+            changesets.emplace_back(cid, user);
+        }
+    });
+    std::sort(changesets.begin(), changesets.end(),
+              [](auto const &a, auto const &b) { return a.first < b.first; });
+
+    file_header header{};
+    std::memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.byte_order = byte_order_mark;
+    header.version = format_version;
+    header.record_size = sizeof(file_record);
+    header.count = changesets.size();
+
+    std::string data(sizeof(file_header) +
+                         changesets.size() * sizeof(file_record),
+                     '\0');
+    std::memcpy(data.data(), &header, sizeof(header));
+
+    // The name of each user is only stored once
+    std::string names;
+    std::unordered_map<osmium::user_id_type, std::size_t> name_offsets;
+    for (std::size_t n = 0; n < changesets.size(); ++n) {
+        auto const &[cid, user] = changesets[n];
+        auto const [it, inserted] =
+            name_offsets.emplace(user.id, names.size());
+        if (inserted) {
+            names += user.name;
+        }
+        file_record const record{cid, it->second, user.id,
+                                 static_cast<uint32_t>(user.name.size())};
+        std::memcpy(data.data() + sizeof(file_header) +
+                        n * sizeof(file_record),
+                    &record, sizeof(record));
+    }
+    data += names;
+
+    // A temporary file left over from a crash is overwritten
+    std::string const tmp_filename{filename + ".new"};
+    ::unlink(tmp_filename.c_str());
+
+    int const fd = excl_write_open(tmp_filename);
+    if (fd < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Can not create changeset cache '" +
+                                    tmp_filename + "'"};
+    }
+
+    osmium::io::detail::reliable_write(fd, data.data(), data.size());
+    osmium::io::detail::reliable_fsync(fd);
+    osmium::io::detail::reliable_close(fd);
+
+    rename_file(tmp_filename, filename);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "cslookup.hpp"
+
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Persistent cache of the user (id and name) of changesets, used by
+ * osmdbt-create-diff. Consecutive diffs mostly contain changes from the
+ * same open changesets, so most lookups are found in the cache of the
+ * last run.
+ *
+ * The file has a small header, then fixed-size records sorted by
+ * changeset id, then all user names. It is written in native byte order
+ * and only meant to be read on the same machine. Lookups are binary
+ * searches over the records.
+ */
+class changeset_cache
+{
+public:
+    /// An empty cache.
+    changeset_cache() = default;
+
+    /**
+     * Read cache from file. A missing file gives an empty cache.
+     *
+     * @throws std::runtime_error if the file can't be read or is invalid.
+     */
+    explicit changeset_cache(std::string const &filename);
+
+    /**
+     * Look up the user of a changeset.
+     *
+     * @returns false if the changeset is not in the cache.
+     */
+    bool find(osmium::changeset_id_type cid, userinfo *user) const;
+
+    /// The number of changesets in the cache.
+    [[nodiscard]] std::size_t size() const noexcept { return m_count; }
+
+    /**
+     * Write all changesets from the lookup table with a known user into a
+     * new cache file, replacing the old one atomically.
+     */
+    static void write(std::string const &filename,
+                      changeset_user_lookup const &lookup);
+
+private:
+    std::string m_data;
+    std::size_t m_count = 0;
+
+}; // class changeset_cache
@@ -0,0 +1,112 @@
+#include "cslookup.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t const initial_slots = 64;
+
+} // anonymous namespace
+
+void changeset_user_lookup::grow()
+{
+    std::vector<slot> old_slots(
+        m_slots.empty() ? initial_slots : m_slots.size() * 2, slot{0, 0});
+    old_slots.swap(m_slots);
+
+    for (auto const &s : old_slots) {
+        if (s.cid != 0) {
+            m_slots[find_slot(s.cid)] = s;
+        }
+    }
+}
+
+changeset_user_lookup::slot *
+changeset_user_lookup::insert(osmium::changeset_id_type cid)
+{
+    // Keep the load factor at or below 1/2, so probe sequences are short
+    if ((m_size + 1) * 2 > m_slots.size()) {
+        grow();
+    }
+
+    auto &s = m_slots[find_slot(cid)];
+    if (s.cid == 0) {
+        s.cid = cid;
+        s.user = 0;
+        ++m_size;
+    }
+    return &s;
+}
+
+void changeset_user_lookup::add(osmium::changeset_id_type cid)
+{
+    if (cid == 0) {
+        m_size += m_has_zero ? 0 : 1;
+        m_has_zero = true;
+        return;
+    }
+    insert(cid);
+}
+
+uint32_t changeset_user_lookup::user_index(osmium::user_id_type uid,
+                                           std::string_view name)
+{
+    if (uid == 0) {
+        return 0;
+    }
+
+    auto const [it, inserted] = m_user_index.emplace(
+        uid, static_cast<uint32_t>(m_users.size()));
+    if (inserted) {
+        m_users.push_back(user_entry{uid, 0, 0});
+    }
+
+    // New user or changed name: append to the pool. The old name stays in
+    // the pool, names hardly ever change during one run.
+    auto &entry = m_users[it->second];
+    if (inserted || to_user(it->second).name != name) {
+        entry.name_offset = m_names.size();
+        entry.name_size = static_cast<uint32_t>(name.size());
+        m_names.append(name);
+    }
+
+    return it->second;
+}
+
+void changeset_user_lookup::set_user(osmium::changeset_id_type cid,
+                                     osmium::user_id_type uid,
+                                     std::string_view name)
+{
+    auto const index = user_index(uid, name);
+    if (cid == 0) {
+        add(0);
+        m_zero_user = index;
+        return;
+    }
+    insert(cid)->user = index;
+}
+
+bool changeset_user_lookup::contains(
+    osmium::changeset_id_type cid) const noexcept
+{
+    if (cid == 0) {
+        return m_has_zero;
+    }
+    return !m_slots.empty() && m_slots[find_slot(cid)].cid == cid;
+}
+
+changeset_user_lookup::user
+changeset_user_lookup::get_slow(osmium::changeset_id_type cid) const
+{
+    if (cid == 0 && m_has_zero) {
+        return to_user(m_zero_user);
+    }
+
+    throw std::out_of_range{"Unknown changeset " + std::to_string(cid)};
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct userinfo
+{
+    osmium::user_id_type id = 0;
+    std::string username;
+};
+
+/**
+ * The user of each changeset referenced by the objects in a diff.
+ *
+ * This is a flat hash map with open addressing and linear probing, keyed
+ * by changeset id. Each slot only has the changeset id and the index of
+ * the user. One user often has many changesets, so user names are stored
+ * only once in a string pool.
+ */
+class changeset_user_lookup
+{
+public:
+    /// User of a changeset. The name is valid until set_user() is called.
+    struct user
+    {
+        osmium::user_id_type id = 0;
+        std::string_view name;
+    };
+
+    /// Add a changeset with an unknown user if it isn't there yet.
+    void add(osmium::changeset_id_type cid);
+
+    /// Set the user of a changeset, adding the changeset if needed.
+    void set_user(osmium::changeset_id_type cid, osmium::user_id_type uid,
+                  std::string_view name);
+
+    [[nodiscard]] bool contains(osmium::changeset_id_type cid) const noexcept;
+
+    /**
+     * Get the user of a changeset. The id is 0 and the name empty if the
+     * user is not known.
+     *
+     * @throws std::out_of_range if the changeset was never added.
+     */
+    [[nodiscard]] user get(osmium::changeset_id_type cid) const
+    {
+        if (cid != 0 && !m_slots.empty()) {
+            auto const &s = m_slots[find_slot(cid)];
+            if (s.cid == cid) {
+                return to_user(s.user);
+            }
+        }
+        return get_slow(cid);
+    }
+
+    /// The number of changesets.
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    [[nodiscard]] bool empty() const noexcept { return m_size == 0; }
+
+    /// Call func(cid, user) for all changesets in no particular order.
+    template <typename TFunc>
+    void for_each(TFunc &&func) const
+    {
+        if (m_has_zero) {
+            func(osmium::changeset_id_type{0}, to_user(m_zero_user));
+        }
+        for (auto const &s : m_slots) {
+            if (s.cid != 0) {
+                func(s.cid, to_user(s.user));
+            }
+        }
+    }
+
+private:
+    struct slot
+    {
+        osmium::changeset_id_type cid; // 0 marks an empty slot
+        uint32_t user;                 // index into m_users
+    };
+
+    struct user_entry
+    {
+        osmium::user_id_type id;
+        uint32_t name_size;
+        std::size_t name_offset;
+    };
+
+    // Fibonacci hashing spreads the mostly consecutive changeset ids over
+    // the table. The table size is always a power of two.
+    [[nodiscard]] std::size_t find_slot(osmium::changeset_id_type cid) const
+        noexcept
+    {
+        auto const mask = m_slots.size() - 1;
+        auto pos = static_cast<std::size_t>(
+                       (static_cast<uint64_t>(cid) * 0x9E3779B97F4A7C15ULL) >>
+                       32U) &
+                   mask;
+        while (m_slots[pos].cid != cid && m_slots[pos].cid != 0) {
+            pos = (pos + 1) & mask;
+        }
+        return pos;
+    }
+
+    [[nodiscard]] user get_slow(osmium::changeset_id_type cid) const;
+
+    slot *insert(osmium::changeset_id_type cid);
+
+    void grow();
+
+    uint32_t user_index(osmium::user_id_type uid, std::string_view name);
+
+    [[nodiscard]] user to_user(uint32_t index) const noexcept
+    {
+        auto const &u = m_users[index];
+        return {u.id, std::string_view{m_names}.substr(u.name_offset,
+                                                         u.name_size)};
+    }
+
+    std::vector<slot> m_slots;
+    std::size_t m_size = 0;
+
+    // Changeset id 0 can't be stored in a slot, it marks empty slots.
+    // There is no such changeset in OSM, but it is handled anyway.
+    bool m_has_zero = false;
+    uint32_t m_zero_user = 0;
+
+    // Entry 0 is the unknown user
+    std::vector<user_entry> m_users{user_entry{0, 0, 0}};
+    std::unordered_map<osmium::user_id_type, uint32_t> m_user_index;
+    std::string m_names;
+
+}; // class changeset_user_lookup
@@ -8,8 +8,10 @@
 #include <fcntl.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <system_error>
 #include <unistd.h>
+#include <utility>
 
 void rename_file(std::string const &old_name, std::string const &new_name)
 {
@@ -92,3 +94,55 @@ PIDFile::~PIDFile()
         ::unlink(m_path.c_str());
     }
 }
+
+IncrementalFile::IncrementalFile(std::string dir_name,
+                                 std::string const &tmp_name)
+: m_dir_name(std::move(dir_name)), m_tmp_path(m_dir_name + tmp_name)
+{
+}
+
+IncrementalFile::~IncrementalFile()
+{
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        ::unlink(m_tmp_path.c_str());
+    }
+}
+
+void IncrementalFile::open()
+{
+    m_fd = excl_write_open(m_tmp_path);
+    if (m_fd < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Can not create file '" + m_tmp_path + "'"};
+    }
+}
+
+void IncrementalFile::write(std::string_view data)
+{
+    if (data.empty()) {
+        return;
+    }
+
+    if (m_fd < 0) {
+        open();
+    }
+
+    osmium::io::detail::reliable_write(m_fd, data.data(), data.size());
+    m_size += data.size();
+}
+
+void IncrementalFile::commit(std::string const &file_name)
+{
+    if (m_fd < 0) {
+        open();
+    }
+
+    int const fd = m_fd;
+    m_fd = -1;
+    osmium::io::detail::reliable_fsync(fd);
+    osmium::io::detail::reliable_close(fd);
+
+    rename_file(m_tmp_path, m_dir_name + file_name);
+    sync_dir(m_dir_name);
+}
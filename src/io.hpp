@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 void rename_file(std::string const &old_name, std::string const &new_name);
 
@@ -28,3 +30,39 @@ private:
     std::string m_path;
 
 }; // class PIDFile
+
+/**
+ * A file written in several pieces. Data goes into a temporary file which
+ * is only opened on the first write. On commit the file is synced and
+ * atomically renamed to its final name. If it is never committed, the
+ * temporary file is removed.
+ */
+class IncrementalFile
+{
+public:
+    IncrementalFile(std::string dir_name, std::string const &tmp_name);
+
+    IncrementalFile(IncrementalFile const &) = delete;
+    IncrementalFile(IncrementalFile &&) = delete;
+
+    IncrementalFile &operator=(IncrementalFile const &) = delete;
+    IncrementalFile &operator=(IncrementalFile &&) = delete;
+
+    ~IncrementalFile();
+
+    void write(std::string_view data);
+
+    /// Number of bytes written so far.
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    void commit(std::string const &file_name);
+
+private:
+    void open();
+
+    std::string m_dir_name;
+    std::string m_tmp_path;
+    std::size_t m_size = 0;
+    int m_fd = -1;
+
+}; // class IncrementalFile
@@ -1,27 +1,33 @@
 
 #include "lsn.hpp"
 
+#include <array>
 #include <cassert>
+#include <charconv>
+#include <cstddef>
 #include <cstdio>
-#include <cstdlib>
 #include <stdexcept>
+#include <string>
+#include <system_error>
 
-lsn_type::lsn_type(char const *lsn)
+lsn_type::lsn_type(std::string_view lsn)
 {
-    assert(lsn);
+    char const *const end = lsn.data() + lsn.size();
 
-    char *end = nullptr;
-    auto const upper_part = std::strtoull(lsn, &end, 16);
+    std::uint64_t upper_part = 0;
+    auto const r1 = std::from_chars(lsn.data(), end, upper_part, 16);
 
-    if (*end != '-' && *end != '/') {
-        throw std::runtime_error{std::string{"Error parsing LSN '"} + lsn +
+    if (r1.ec != std::errc{} || r1.ptr == end ||
+        (*r1.ptr != '-' && *r1.ptr != '/')) {
+        throw std::runtime_error{"Error parsing LSN '" + std::string{lsn} +
                                  "'"};
     }
 
-    auto const lower_part = std::strtoull(end + 1, &end, 16);
+    std::uint64_t lower_part = 0;
+    auto const r2 = std::from_chars(r1.ptr + 1, end, lower_part, 16);
 
-    if (*end != '\0') {
-        throw std::runtime_error{std::string{"Error parsing LSN '"} + lsn +
+    if (r2.ec != std::errc{} || r2.ptr != end) {
+        throw std::runtime_error{"Error parsing LSN '" + std::string{lsn} +
                                  "'"};
     }
 
@@ -30,12 +36,15 @@ lsn_type::lsn_type(char const *lsn)
 
 std::string lsn_type::str() const
 {
-    std::string result(20, 'x');
+    std::array<char, format_buffer_size> buffer{};
+    return std::string{format(buffer.data())};
+}
 
-    int const n = std::snprintf(result.data(), result.size(), "%lX/%lX",
+std::string_view lsn_type::format(char *buffer) const noexcept
+{
+    int const n = std::snprintf(buffer, format_buffer_size, "%lX/%lX",
                                 upper(), lower());
     assert(n > 0);
-    result.resize(n);
 
-    return result;
+    return {buffer, static_cast<std::size_t>(n)};
 }
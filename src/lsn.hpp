@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 /**
  * An implementation of the PostgreSQL LSN (Log Sequence Number) type.
@@ -13,9 +15,15 @@ class lsn_type
 public:
     lsn_type() = default;
 
-    explicit lsn_type(char const *lsn);
+    explicit lsn_type(std::string_view lsn);
 
-    explicit lsn_type(std::string const &lsn) : lsn_type(lsn.c_str()) {}
+    explicit lsn_type(char const *lsn) : lsn_type(std::string_view{lsn}) {}
+
+    explicit lsn_type(std::string const &lsn) : lsn_type(std::string_view{lsn})
+    {
+    }
+
+    explicit lsn_type(std::uint64_t lsn) noexcept : m_lsn(lsn) {}
 
     [[nodiscard]] std::uint64_t value() const noexcept { return m_lsn; }
 
@@ -30,6 +38,16 @@ public:
 
     [[nodiscard]] std::string str() const;
 
+    /// Size of a buffer for format().
+    static constexpr std::size_t const format_buffer_size = 18;
+
+    /**
+     * Write the text representation into a buffer of (at least)
+     * format_buffer_size characters and return it. Unlike str() this
+     * doesn't allocate.
+     */
+    std::string_view format(char *buffer) const noexcept;
+
     friend bool operator<(lsn_type lhs, lsn_type rhs) noexcept
     {
         return lhs.m_lsn < rhs.m_lsn;
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "exception.hpp"
+#include "osmobj.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+/**
+ * Text of a column in a query result. Works with pqxx::field and
+ * everything else with the same c_str() and size() interface.
+ */
+template <typename TField>
+std::string_view field_view(TField const &field)
+{
+    return {field.c_str(), field.size()};
+}
+
+/**
+ * Parse an integer from a column in text format.
+ *
+ * @throws database_error if it is not a valid number of this type.
+ */
+template <typename T>
+T parse_number(std::string_view str)
+{
+    T value{};
+    auto const *const last = str.data() + str.size();
+    auto const [ptr, ec] = std::from_chars(str.data(), last, value);
+    if (ec != std::errc{} || ptr != last || str.empty()) {
+        throw database_error{"Invalid number in query result: '" +
+                             std::string{str} + "'"};
+    }
+    return value;
+}
+
+/**
+ * How the typed values are read from the columns of a row. This is for
+ * rows in text format like pqxx::row, specialize it for rows in other
+ * formats.
+ */
+template <typename TRow>
+struct row_format
+{
+    using size_type = typename TRow::size_type;
+
+    template <typename T>
+    [[nodiscard]] static T number(TRow const &row, size_type col)
+    {
+        return parse_number<T>(field_view(row[col]));
+    }
+
+    [[nodiscard]] static bool boolean(TRow const &row, size_type col)
+    {
+        return row[col].c_str()[0] == 't';
+    }
+
+    [[nodiscard]] static bool is_null(TRow const &row, size_type col)
+    {
+        return row[col].is_null();
+    }
+
+}; // struct row_format
+
+/**
+ * Column numbers of the attributes in results of the object queries of
+ * osmdbt-create-diff. They are looked up once per result, the functions
+ * to access the typed values of a row then use the numbers.
+ *
+ * The timestamp is expected in seconds since the epoch.
+ *
+ * TRow is pqxx::row or anything else with the same interface, or a row
+ * in another format for which row_format is specialized.
+ */
+template <typename TRow>
+class object_columns
+{
+    using format = row_format<TRow>;
+
+public:
+    using size_type = typename TRow::size_type;
+
+    template <typename TResult>
+    object_columns(TResult const &result, char const *id_column)
+    : m_id(result.column_number(id_column)),
+      m_version(result.column_number("version")),
+      m_changeset(result.column_number("changeset_id")),
+      m_visible(result.column_number("visible")),
+      m_timestamp(result.column_number("timestamp")),
+      m_redaction(result.column_number("redaction_id"))
+    {
+    }
+
+    [[nodiscard]] osmium::object_id_type id(TRow const &row) const
+    {
+        return format::template number<osmium::object_id_type>(row, m_id);
+    }
+
+    [[nodiscard]] osmium::object_version_type version(TRow const &row) const
+    {
+        return format::template number<osmium::object_version_type>(
+            row, m_version);
+    }
+
+    [[nodiscard]] osmium::Timestamp timestamp(TRow const &row) const
+    {
+        return osmium::Timestamp{
+            format::template number<uint32_t>(row, m_timestamp)};
+    }
+
+    [[nodiscard]] bool visible(TRow const &row) const
+    {
+        return format::boolean(row, m_visible);
+    }
+
+    [[nodiscard]] bool is_redacted(TRow const &row) const
+    {
+        return !format::is_null(row, m_redaction);
+    }
+
+    [[nodiscard]] int64_t redaction_id(TRow const &row) const
+    {
+        return format::template number<int64_t>(row, m_redaction);
+    }
+
+    /**
+     * Set the attributes of the object. The user comes from the changeset
+     * lookup. The id, version, and timestamp have been read from the row
+     * before.
+     */
+    template <typename TBuilder>
+    void set_attributes(TBuilder &builder, TRow const &row,
+                        changeset_user_lookup const &cucache,
+                        osmium::object_id_type id,
+                        osmium::object_version_type version,
+                        osmium::Timestamp timestamp) const
+    {
+        auto const cid = format::template number<osmium::changeset_id_type>(
+            row, m_changeset);
+        auto const user = cucache.get(cid);
+
+        builder.set_id(id)
+            .set_version(version)
+            .set_changeset(cid)
+            .set_visible(visible(row))
+            .set_uid(user.id)
+            .set_timestamp(timestamp)
+            .set_user(user.name.data(),
+                      static_cast<osmium::string_size_type>(user.name.size()));
+    }
+
+private:
+    size_type m_id;
+    size_type m_version;
+    size_type m_changeset;
+    size_type m_visible;
+    size_type m_timestamp;
+    size_type m_redaction;
+
+}; // class object_columns
+
+/// Column numbers of node results: the attributes and the location.
+template <typename TRow>
+class node_columns : public object_columns<TRow>
+{
+public:
+    using size_type = typename TRow::size_type;
+
+    template <typename TResult>
+    explicit node_columns(TResult const &result)
+    : object_columns<TRow>(result, "node_id"),
+      m_longitude(result.column_number("longitude")),
+      m_latitude(result.column_number("latitude"))
+    {
+    }
+
+    [[nodiscard]] osmium::Location location(TRow const &row) const
+    {
+        using format = row_format<TRow>;
+        return osmium::Location{
+            format::template number<int64_t>(row, m_longitude),
+            format::template number<int64_t>(row, m_latitude)};
+    }
+
+private:
+    size_type m_longitude;
+    size_type m_latitude;
+
+}; // class node_columns
@@ -18,14 +18,14 @@ namespace {
 lsn_type get_lsn(Config const &config)
 {
     std::regex const re{
-        R"(osm-repl-\d\d\d\d-\d\d-\d\dT\d\d:\d\d:\d\dZ-lsn-([0-9A-F]+-[0-9A-F]+)\.log)"};
+        R"(osm-repl-\d\d\d\d-\d\d-\d\dT\d\d:\d\d:\d\dZ-lsn-([0-9A-F]+-[0-9A-F]+)\.(?:b?log|log\.gz|log\.zst))"};
 
     lsn_type lsn;
 
     std::filesystem::path const p{config.log_dir()};
     for (auto const &file : std::filesystem::directory_iterator(p)) {
-        if (file.path().extension() == ".log") {
-            std::string const fn = file.path().filename().string();
+        std::string const fn = file.path().filename().string();
+        if (is_log_file_name(fn)) {
             std::cmatch m;
             bool const has_match = std::regex_match(fn.c_str(), m, re);
             if (has_match && m.size() == 2) {
@@ -0,0 +1,165 @@
+#include "binlog.hpp"
+#include "config.hpp"
+#include "exception.hpp"
+#include "options.hpp"
+#include "util.hpp"
+
+#include <osmium/util/verbose_output.hpp>
+
+#include <cerrno>
+#include <cstddef>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+namespace {
+
+class ConvertLogOptions : public Options
+{
+public:
+    ConvertLogOptions()
+    : Options("convert-log",
+              "Convert log file between text and binary format.")
+    {}
+
+    [[nodiscard]] std::string const &log_file_name() const noexcept
+    {
+        return m_log_file_name;
+    }
+
+    [[nodiscard]] std::string const &output_file_name() const noexcept
+    {
+        return m_output_file_name;
+    }
+
+private:
+    void add_command_options(po::options_description &desc) override
+    {
+        po::options_description opts_cmd{"COMMAND OPTIONS"};
+
+        // clang-format off
+        opts_cmd.add_options()
+            ("log,l", po::value<std::string>(), "Log file to convert")
+            ("output,o", po::value<std::string>(), "Output file (default: stdout)");
+        // clang-format on
+
+        desc.add(opts_cmd);
+    }
+
+    void check_command_options(po::variables_map const &vm) override
+    {
+        if (vm.count("log")) {
+            m_log_file_name = vm["log"].as<std::string>();
+            if (m_log_file_name.empty()) {
+                throw argument_error{"Log file name must not be empty"};
+            }
+        } else {
+            throw argument_error{
+                "Missing '--log=FILE' or '-l FILE' on command line"};
+        }
+
+        if (vm.count("output")) {
+            m_output_file_name = vm["output"].as<std::string>();
+        }
+    }
+
+    std::string m_log_file_name;
+    std::string m_output_file_name;
+
+}; // class ConvertLogOptions
+
+// Error entries are converted, but they should never happen, so they are
+// reported.
+void report_error(blog::record const &rec)
+{
+    if (rec.op != 'X') {
+        return;
+    }
+
+    std::string line;
+    blog::append_text(&line, rec);
+    std::cerr << "Error found in logfile: " << line;
+}
+
+std::string binary_to_text(std::string const &path)
+{
+    blog::mapped_file const logfile{path};
+
+    std::string text;
+    for (std::size_t n = 0; n < logfile.size(); ++n) {
+        auto const rec = logfile.get(n);
+        report_error(rec);
+        blog::append_text(&text, rec);
+    }
+
+    return text;
+}
+
+std::string text_to_binary(std::string const &path)
+{
+    std::ifstream logfile{path, std::ios::binary};
+    if (!logfile.is_open()) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not open log file '" + path + "'"};
+    }
+
+    std::string const text{std::istreambuf_iterator<char>{logfile},
+                           std::istreambuf_iterator<char>{}};
+
+    auto const records = blog::text_to_records(text);
+    for (std::size_t offset = 0; offset < records.size();
+         offset += sizeof(blog::record)) {
+        blog::record rec{};
+        records.copy(reinterpret_cast<char *>(&rec), sizeof(rec), offset);
+        report_error(rec);
+    }
+
+    return blog::file_data(records);
+}
+
+void write_output(std::string const &data, std::string const &file_name)
+{
+    if (file_name.empty()) {
+        std::cout.write(data.data(), static_cast<std::streamsize>(data.size()));
+        std::cout.flush();
+        return;
+    }
+
+    std::ofstream file{file_name, std::ios::binary | std::ios::trunc};
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    file.close();
+    if (!file) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not write output file '" + file_name +
+                                    "'"};
+    }
+}
+
+} // anonymous namespace
+
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         ConvertLogOptions const &options)
+{
+    auto const &log = options.log_file_name();
+    std::string const path = (log[0] == '/' ? "" : config.log_dir()) + log;
+
+    if (blog::is_binary_log_name(log)) {
+        vout << "Converting binary log '" << path << "' to text format...\n";
+        write_output(binary_to_text(path), options.output_file_name());
+    } else {
+        vout << "Converting text log '" << path << "' to binary format...\n";
+        write_output(text_to_binary(path), options.output_file_name());
+    }
+
+    vout << "Done.\n";
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    ConvertLogOptions options;
+    return app_wrapper(options, argc, argv);
+}
@@ -1,9 +1,14 @@
 
 #include "config.hpp"
+#include "cscache.hpp"
 #include "db.hpp"
 #include "io.hpp"
 #include "options.hpp"
+#include "objrow.hpp"
 #include "osmobj.hpp"
+#include "pgarray.hpp"
+#include "pq.hpp"
+#include "queue.hpp"
 #include "state.hpp"
 #include "util.hpp"
 #include "version.hpp"
@@ -11,20 +16,36 @@
 #include <osmium/io/gzip_compression.hpp>
 #include <osmium/io/xml_output.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/osm/item_type.hpp>
 #include <osmium/osm/types.hpp>
 #include <osmium/util/memory.hpp>
 #include <osmium/util/string.hpp>
 #include <osmium/util/verbose_output.hpp>
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <limits>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace {
 
+enum class query_mode
+{
+    join,     // separate queries for objects, tags, way nodes, and members
+    aggregate // one query with tags, way nodes, and members as arrays
+};
+
 class CreateDiffOptions : public Options
 {
 public:
@@ -48,6 +69,21 @@ public:
         return m_max_changes;
     }
 
+    [[nodiscard]] std::size_t batch_size() const noexcept
+    {
+        return m_batch_size;
+    }
+
+    [[nodiscard]] enum query_mode query_mode() const noexcept
+    {
+        return m_query_mode;
+    }
+
+    [[nodiscard]] unsigned int fetch_threads() const noexcept
+    {
+        return m_fetch_threads;
+    }
+
     [[nodiscard]] bool with_comment() const noexcept { return m_with_comment; }
 
     [[nodiscard]] bool dry_run() const noexcept { return m_dry_run; }
@@ -60,6 +96,9 @@ private:
         // clang-format off
         opts_cmd.add_options()
             ("with-comment", "Add comment to state file with current date")
+            ("batch-size", po::value<std::size_t>(), "Number of objects read from the database at once (default: 100000)")
+            ("fetch-threads", po::value<unsigned int>(), "Number of threads/connections reading objects (default: 1)")
+            ("query-mode", po::value<std::string>(), "How to query objects: 'join' (default) or 'aggregate'")
             ("log-file,f", po::value<std::vector<std::string>>(), "Read specified log file")
             ("max-changes,m", po::value<uint32_t>(), "Maximum number of changes (default: no limit)")
             ("dry-run,n", "Dry-run, only create files in tmp dir")
@@ -77,6 +116,27 @@ private:
         if (vm.count("max-changes")) {
             m_max_changes = vm["max-changes"].as<uint32_t>();
         }
+        if (vm.count("batch-size")) {
+            m_batch_size = vm["batch-size"].as<std::size_t>();
+            if (m_batch_size == 0) {
+                throw argument_error{"--batch-size must be at least 1"};
+            }
+        }
+        if (vm.count("fetch-threads")) {
+            m_fetch_threads = vm["fetch-threads"].as<unsigned int>();
+            if (m_fetch_threads == 0) {
+                throw argument_error{"--fetch-threads must be at least 1"};
+            }
+        }
+        if (vm.count("query-mode")) {
+            auto const &mode = vm["query-mode"].as<std::string>();
+            if (mode == "aggregate") {
+                m_query_mode = query_mode::aggregate;
+            } else if (mode != "join") {
+                throw argument_error{
+                    "--query-mode must be 'join' or 'aggregate'"};
+            }
+        }
         if (vm.count("with-comment")) {
             m_with_comment = true;
         }
@@ -91,35 +151,90 @@ private:
     std::vector<std::string> m_log_file_names;
     std::size_t m_init_state = 0;
     std::uint32_t m_max_changes = std::numeric_limits<uint32_t>::max();
+    std::size_t m_batch_size = 100000;
+    unsigned int m_fetch_threads = 1;
+    enum query_mode m_query_mode = query_mode::join;
     bool m_with_comment = false;
     bool m_dry_run = false;
 
 }; // class CreateDiffOptions
 
-void populate_changeset_cache(pqxx::dbtransaction &txn,
+template <typename TContainer>
+std::string array_literal(TContainer const &ids)
+{
+    assert(!ids.empty());
+
+    std::string literal{"{"};
+    for (auto const id : ids) {
+        literal += std::to_string(id);
+        literal += ',';
+    }
+    literal.back() = '}';
+
+    return literal;
+}
+
+void populate_changeset_cache(osmium::VerboseOutput &vout,
+                              pqxx::dbtransaction &txn,
+                              changeset_cache const &cscache,
                               changeset_user_lookup &cucache)
 {
     assert(!cucache.empty());
 
-    std::string query{
-        "SELECT c.id, c.user_id, u.display_name FROM changesets c, users u"
-        "  WHERE c.user_id = u.id AND c.id IN ("};
+    std::vector<osmium::changeset_id_type> misses;
+    std::vector<std::pair<osmium::changeset_id_type, userinfo>> hits;
+    cucache.for_each([&](osmium::changeset_id_type cid,
+                         changeset_user_lookup::user const & /*user*/) {
+        userinfo user;
+        if (cscache.find(cid, &user)) {
+            hits.emplace_back(cid, std::move(user));
+        } else {
+            misses.push_back(cid);
+        }
+    });
+
+    vout << "  Found " << hits.size() << " changesets in cache, reading "
+         << misses.size() << " from database.\n";
+
+    if (!misses.empty()) {
+        pqxx::result const result =
+            txn.exec_prepared("changeset_users", array_literal(misses));
+        for (auto const &row : result) {
+            auto const cid = row[0].as<osmium::changeset_id_type>();
+            auto const uid = row[1].as<osmium::user_id_type>();
+            cucache.set_user(cid, uid, field_view(row[2]));
+        }
+    }
 
-    for (auto const &c : cucache) {
-        query += std::to_string(c.first);
-        query += ",";
+    if (hits.empty()) {
+        return;
     }
 
-    query.back() = ')';
+    // The user of a changeset never changes, but users can change their
+    // name. So names from the cache are always checked against the users
+    // table.
+    std::vector<osmium::user_id_type> uids;
+    uids.reserve(hits.size());
+    for (auto const &hit : hits) {
+        uids.push_back(hit.second.id);
+    }
+    std::sort(uids.begin(), uids.end());
+    uids.erase(std::unique(uids.begin(), uids.end()), uids.end());
 
-    pqxx::result const result = txn.exec(query);
+    std::unordered_map<osmium::user_id_type, std::string> names;
+    pqxx::result const result =
+        txn.exec_prepared("user_names", array_literal(uids));
     for (auto const &row : result) {
-        auto const cid = row[0].as<osmium::changeset_id_type>();
-        auto const uid = row[1].as<osmium::user_id_type>();
-        auto const *const username = row[2].c_str();
-        auto &ui = cucache[cid];
-        ui.id = uid;
-        ui.username = username;
+        names[row[0].as<osmium::user_id_type>()] = row[1].c_str();
+    }
+
+    for (auto const &[cid, user] : hits) {
+        auto const it = names.find(user.id);
+        if (it == names.end()) {
+            cucache.set_user(cid, 0, {});
+        } else {
+            cucache.set_user(cid, user.id, it->second);
+        }
     }
 }
 
@@ -171,109 +286,221 @@ void write_lock_file(std::string const &path, State const &state,
     osmium::io::detail::reliable_close(fd);
 }
 
-std::string wanted(std::vector<osmobj> const &objs)
+/**
+ * The ids and versions of the objects we want from the database as
+ * PostgreSQL array literals. They are the parameters of the prepared
+ * statements (see prepare_queries()), which join the tables against
+ * unnest($1::bigint[], $2::bigint[]). This way the query text doesn't
+ * depend on the number of objects and is only parsed and planned once.
+ */
+using objs_iterator = std::vector<osmobj>::const_iterator;
+
+struct wanted
 {
-    assert(!objs.empty());
+    std::string ids{"{"};
+    std::string versions{"{"};
 
-    std::string sql{"WITH wanted(id, version) AS (VALUES "};
+    wanted(objs_iterator first, objs_iterator last)
+    {
+        assert(first != last);
 
-    for (auto const &obj : objs) {
-        sql += '(';
-        sql += std::to_string(obj.id());
-        sql += ',';
-        sql += std::to_string(obj.version());
-        sql += "),";
+        for (; first != last; ++first) {
+            ids += std::to_string(first->id());
+            ids += ',';
+            versions += std::to_string(first->version());
+            versions += ',';
+        }
+        ids.back() = '}';
+        versions.back() = '}';
     }
-    sql.back() = ')';
-    sql += ' ';
-
-    return sql;
-}
-
-struct tag
-{
-    std::string key;
-    std::string value;
-    osmium::object_id_type id;
-    osmium::object_version_type version;
-
-    tag(osmium::object_id_type id_, osmium::object_version_type version_,
-        char const *key_, char const *value_)
-    : key(key_), value(value_), id(id_), version(version_)
-    {}
 };
 
-std::vector<tag> get_tags(pqxx::dbtransaction &txn, char const *type,
-                          std::string const &wanted)
+char const attr[] =
+    ", o.version, o.changeset_id, o.visible,"
+    " EXTRACT(EPOCH FROM date_trunc('second', o.timestamp))::int8 AS timestamp,"
+    " o.redaction_id";
+
+char const join_wanted[] =
+    " INNER JOIN unnest($1::bigint[], $2::bigint[]) AS w(id, version)";
+
+// Tags, way nodes and members of each object as arrays in one row for
+// --query-mode=aggregate. The aggregates always return one row, which is
+// NULL if there are no tags, nodes, or members. The query is read as a
+// pq::row_stream in binary format, so the arrays don't have to be parsed
+// from text. All columns and array elements are cast, so the binary
+// format is known.
+std::string aggregated_query(std::string const &type)
 {
-    std::string query = wanted;
+    std::string query{"SELECT o." + type + "_id::int8, o.version::int8,"
+                      " o.changeset_id::int8, o.visible,"
+                      " EXTRACT(EPOCH FROM date_trunc('second', o.timestamp))::int8 AS timestamp,"
+                      " o.redaction_id::int8"};
+    if (type == "node") {
+        query += ", o.longitude::int8, o.latitude::int8";
+    }
+    query += ", t.tag_keys, t.tag_values";
+    if (type == "way") {
+        query += ", wn.way_nodes";
+    } else if (type == "relation") {
+        query += ", m.member_types, m.member_ids, m.member_roles";
+    }
 
-    query += "SELECT w.id, w.version, t.k, t.v FROM ";
-    query += type;
-    query += "_tags t INNER JOIN wanted w ON t.";
-    query += type;
-    query += "_id = w.id AND t.version = w.version"
-             "  ORDER BY w.id, w.version, t.k COLLATE \"C\"";
+    query += "  FROM " + type + "s o" + join_wanted + " ON o." + type +
+             "_id = w.id AND o.version = w.version"
+             "  CROSS JOIN LATERAL (SELECT"
+             "    array_agg(t.k::text ORDER BY t.k COLLATE \"C\") AS tag_keys,"
+             "    array_agg(t.v::text ORDER BY t.k COLLATE \"C\") AS tag_values"
+             "    FROM " +
+             type + "_tags t WHERE t." + type + "_id = o." + type +
+             "_id AND t.version = o.version) t";
+
+    if (type == "way") {
+        query += "  CROSS JOIN LATERAL (SELECT"
+                 "    array_agg(wn.node_id::int8 ORDER BY wn.sequence_id)"
+                 "      AS way_nodes"
+                 "    FROM way_nodes wn"
+                 "    WHERE wn.way_id = o.way_id AND wn.version = o.version) wn";
+    } else if (type == "relation") {
+        query +=
+            "  CROSS JOIN LATERAL (SELECT"
+            "    array_agg(m.member_type::text ORDER BY m.sequence_id)"
+            "      AS member_types,"
+            "    array_agg(m.member_id::int8 ORDER BY m.sequence_id)"
+            "      AS member_ids,"
+            "    array_agg(m.member_role::text ORDER BY m.sequence_id)"
+            "      AS member_roles"
+            "    FROM relation_members m WHERE m.relation_id = o.relation_id"
+            "      AND m.version = o.version) m";
+    }
 
-    std::vector<tag> tags;
+    query += "  ORDER BY w.id, w.version";
 
-    pqxx::result const result = txn.exec(query);
-    for (auto const &row : result) {
-        tags.emplace_back(row[0].as<osmium::object_id_type>(),
-                          row[1].as<osmium::object_version_type>(),
-                          row[2].c_str(), row[3].c_str());
-    }
+    return query;
+}
 
-    return tags;
+void prepare_queries(pqxx::connection &db)
+{
+    db.prepare("changeset_users",
+               "SELECT c.id, c.user_id, u.display_name"
+               "  FROM changesets c INNER JOIN users u ON c.user_id = u.id"
+               "  WHERE c.id = ANY($1::bigint[])");
+
+    db.prepare("user_names", "SELECT id, display_name FROM users"
+                             "  WHERE id = ANY($1::bigint[])");
+
+    for (std::string const type : {"node", "way", "relation"}) {
+        db.prepare(type + "s", "SELECT o." + type + "_id" + attr +
+                                   (type == "node"
+                                        ? ", o.longitude, o.latitude"
+                                        : "") +
+                                   "  FROM " + type + "s o" + join_wanted +
+                                   " ON o." + type +
+                                   "_id = w.id AND o.version = w.version"
+                                   "  ORDER BY w.id, w.version");
+    }
 }
 
-struct way_node
+pqxx::result exec_wanted(pqxx::dbtransaction &txn, std::string const &query,
+                         wanted const &objs)
 {
-    osmium::object_id_type way_id;
-    osmium::object_id_type node_ref;
-    osmium::object_version_type version;
+    return txn.exec_prepared(query, objs.ids, objs.versions);
+}
 
-    way_node(osmium::object_id_type wid, osmium::object_version_type v,
-             osmium::object_id_type nref)
-    : way_id(wid), node_ref(nref), version(v)
-    {}
-};
+// Tags, way nodes, and members are by far the largest results. They are
+// read from a second connection in binary format, so the integers don't
+// have to be converted to and from text. They are sorted like the objects
+// and merged with them while the objects are built, so only a chunk of
+// each is in memory at any time. If only one of them is needed (the tags
+// of nodes), it is read as a pq::row_stream, which saves the round trip
+// per chunk. Ways and relations need two of them at the same time on the
+// connection, they are read through cursors. All columns are cast, so the
+// binary format is known.
+
+constexpr int const rows_per_fetch = 10000;
 
-std::vector<way_node> get_nodes(pqxx::dbtransaction &txn,
-                                std::string const &wanted)
+std::string tags_query(std::string const &type)
 {
-    std::string query = wanted;
+    return "SELECT w.id::int8, w.version::int8, t.k::text, t.v::text"
+           "  FROM " +
+           type + "_tags t" + join_wanted + " ON t." + type +
+           "_id = w.id AND t.version = w.version"
+           "  ORDER BY w.id, w.version, t.k COLLATE \"C\"";
+}
 
-    query +=
-        "SELECT wn.way_id, wn.version, wn.node_id FROM way_nodes wn"
-        "  INNER JOIN wanted w ON wn.way_id = w.id AND wn.version = w.version"
-        "  ORDER BY wn.way_id, wn.version, wn.sequence_id";
+char const way_nodes_query[] =
+    "SELECT wn.way_id::int8, wn.version::int8, wn.node_id::int8"
+    "  FROM way_nodes wn"
+    " INNER JOIN unnest($1::bigint[], $2::bigint[]) AS w(id, version)"
+    " ON wn.way_id = w.id AND wn.version = w.version"
+    "  ORDER BY wn.way_id, wn.version, wn.sequence_id";
+
+char const members_query[] =
+    "SELECT m.relation_id::int8, m.version::int8, m.member_type::text,"
+    "    m.member_id::int8, m.member_role::text"
+    "  FROM relation_members m"
+    " INNER JOIN unnest($1::bigint[], $2::bigint[]) AS w(id, version)"
+    " ON m.relation_id = w.id AND m.version = w.version"
+    "  ORDER BY m.relation_id, m.version, m.sequence_id";
+
+/**
+ * Rows of the tags, way nodes, or members query. The first two columns
+ * are the id and version of the parent object.
+ *
+ * TRows is pq::cursor or pq::row_stream.
+ */
+template <typename TRows>
+class child_stream
+{
+public:
+    /// Read the rows through a cursor with the specified name.
+    child_stream(pq::connection *db, char const *name,
+                 std::string const &query, wanted const &objs)
+    : m_rows(db, name, query, {objs.ids, objs.versions}, rows_per_fetch)
+    {
+    }
 
-    std::vector<way_node> way_nodes;
+    /// Read the rows as a row_stream.
+    child_stream(pq::connection *db, std::string const &query,
+                 wanted const &objs)
+    : m_rows(db, query, {objs.ids, objs.versions})
+    {
+    }
 
-    pqxx::result const result = txn.exec(query);
-    for (auto const &row : result) {
-        way_nodes.emplace_back(row[0].as<osmium::object_id_type>(),
-                               row[1].as<osmium::object_version_type>(),
-                               row[2].as<osmium::object_id_type>());
+    /**
+     * Skip rows of objects before the one with the specified id and
+     * version (for instance of redacted objects) and return true if the
+     * current row belongs to this object.
+     */
+    bool seek(osmium::object_id_type id, osmium::object_version_type v)
+    {
+        auto const version = static_cast<std::int64_t>(v);
+        while (!m_rows.at_end()) {
+            auto const row_id = m_rows.get_int64(0);
+            auto const row_version = m_rows.get_int64(1);
+            if (row_id > id || (row_id == id && row_version >= version)) {
+                return row_id == id && row_version == version;
+            }
+            m_rows.next();
+        }
+        return false;
     }
 
-    return way_nodes;
-}
+    /// Go to the next row and return true if it belongs to the same object.
+    bool next()
+    {
+        auto const id = m_rows.get_int64(0);
+        auto const version = m_rows.get_int64(1);
+        m_rows.next();
+        return !m_rows.at_end() && m_rows.get_int64(0) == id &&
+               m_rows.get_int64(1) == version;
+    }
 
-struct member
-{
-    std::string mrole;
-    osmium::object_id_type relation_id;
-    osmium::object_id_type mref;
-    osmium::object_version_type version;
-    osmium::item_type mtype;
+    [[nodiscard]] TRows const &row() const noexcept { return m_rows; }
 
-    member(osmium::object_id_type rid, osmium::object_version_type v,
-           osmium::item_type type, osmium::object_id_type ref, char const *role)
-    : mrole(role), relation_id(rid), mref(ref), version(v), mtype(type)
-    {}
-};
+private:
+    TRows m_rows;
+
+}; // class child_stream
 
 osmium::item_type type_from_char(char const *str) noexcept
 {
@@ -292,275 +519,694 @@ osmium::item_type type_from_char(char const *str) noexcept
     return osmium::item_type::undefined;
 }
 
-std::vector<member> get_members(pqxx::dbtransaction &txn,
-                                std::string const &wanted)
+template <typename TRows>
+void add_tags(child_stream<TRows> *tags, osmium::object_id_type id,
+              osmium::object_version_type version,
+              osmium::builder::Builder &builder)
 {
-    std::string query = wanted;
+    if (!tags->seek(id, version)) {
+        return;
+    }
+
+    osmium::builder::TagListBuilder tbuilder{builder};
+    do {
+        auto const &row = tags->row();
+        auto const key = row.get(2);
+        auto const value = row.get(3);
+        tbuilder.add_tag(key.data(), key.size(), value.data(), value.size());
+    } while (tags->next());
+}
 
-    query += "SELECT m.relation_id, m.version, m.member_type,"
-             "    m.member_id, m.member_role FROM relation_members m"
-             "  INNER JOIN wanted w"
-             "    ON m.relation_id = w.id AND m.version = w.version"
-             "  ORDER BY m.relation_id, m.version, m.sequence_id";
+void add_way_nodes(child_stream<pq::cursor> *way_nodes, osmium::object_id_type id,
+                   osmium::object_version_type version,
+                   osmium::builder::Builder &builder)
+{
+    if (!way_nodes->seek(id, version)) {
+        return;
+    }
 
-    std::vector<member> members;
+    osmium::builder::WayNodeListBuilder wnbuilder{builder};
+    do {
+        wnbuilder.add_node_ref(way_nodes->row().get_int64(2));
+    } while (way_nodes->next());
+}
 
-    pqxx::result const result = txn.exec(query);
-    for (auto const &row : result) {
-        members.emplace_back(row["relation_id"].as<osmium::object_id_type>(),
-                             row["version"].as<osmium::object_version_type>(),
-                             type_from_char(row["member_type"].c_str()),
-                             row["member_id"].as<osmium::object_id_type>(),
-                             row["member_role"].c_str());
+void add_members(child_stream<pq::cursor> *members, osmium::object_id_type id,
+                 osmium::object_version_type version,
+                 osmium::builder::Builder &builder)
+{
+    if (!members->seek(id, version)) {
+        return;
     }
 
-    return members;
+    osmium::builder::RelationMemberListBuilder mbuilder{builder};
+    do {
+        auto const &row = members->row();
+        auto const type = row.get(2);
+        auto const role = row.get(4);
+        if (type.empty()) {
+            throw database_error{"Empty member type"};
+        }
+        mbuilder.add_member(type_from_char(type.data()), row.get_int64(3),
+                            role.data(), role.size());
+    } while (members->next());
 }
 
-using tags_iterator = std::vector<tag>::const_iterator;
-using way_nodes_iterator = std::vector<way_node>::const_iterator;
-using members_iterator = std::vector<member>::const_iterator;
+/**
+ * The current row of an aggregated query with the interface
+ * object_columns needs. It is the only query on the connection, so it is
+ * read as a pq::row_stream. All columns are in binary format, their values
+ * are read by row_format<binary_row> below.
+ */
+class binary_row
+{
+public:
+    using size_type = int;
 
-tags_iterator add_tags(tags_iterator it, tags_iterator end,
-                       osmium::object_id_type id,
-                       osmium::object_version_type version,
-                       osmium::builder::Builder &builder)
+    explicit binary_row(pq::row_stream const &rows) noexcept
+    : m_rows(&rows)
+    {}
+
+    [[nodiscard]] std::string_view get(int col) const noexcept
+    {
+        return m_rows->get(col);
+    }
+
+    [[nodiscard]] bool is_null(int col) const noexcept
+    {
+        return m_rows->is_null(col);
+    }
+
+private:
+    pq::row_stream const *m_rows;
+
+}; // class binary_row
+
+} // anonymous namespace
+
+/// Integers are all int8 and booleans are one byte in binary format.
+template <>
+struct row_format<binary_row>
 {
-    if (it == end || it->id != id || it->version != version) {
-        return it;
+    template <typename T>
+    [[nodiscard]] static T number(binary_row const &row, int col)
+    {
+        auto const value = pq::int64_from_binary(row.get(col));
+        if (value < std::numeric_limits<T>::min() ||
+            value > std::numeric_limits<T>::max()) {
+            throw database_error{"Invalid number in query result"};
+        }
+        return static_cast<T>(value);
     }
 
-    osmium::builder::TagListBuilder tbuilder{builder};
-    do {
-        tbuilder.add_tag(it->key, it->value);
-        ++it;
-    } while (it != end && it->id == id && it->version == version);
+    [[nodiscard]] static bool boolean(binary_row const &row, int col)
+    {
+        auto const data = row.get(col);
+        return data.size() == 1 && data[0] != 0;
+    }
 
-    return it;
-}
+    [[nodiscard]] static bool is_null(binary_row const &row, int col)
+    {
+        return row.is_null(col);
+    }
+
+}; // struct row_format<binary_row>
 
-way_nodes_iterator add_way_nodes(way_nodes_iterator it, way_nodes_iterator end,
-                                 osmium::object_id_type id,
-                                 osmium::object_version_type version,
-                                 osmium::builder::Builder &builder)
+namespace {
+
+/// Column numbers of the arrays in results of the aggregated queries.
+struct array_columns
 {
-    if (it == end || it->way_id != id || it->version != version) {
-        return it;
+    int tag_keys;
+    int tag_values;
+    int way_nodes = 0;
+    int member_types = 0;
+    int member_ids = 0;
+    int member_roles = 0;
+
+    array_columns(pq::row_stream const &rows, osmium::item_type type)
+    : tag_keys(rows.column_number("tag_keys")),
+      tag_values(rows.column_number("tag_values"))
+    {
+        if (type == osmium::item_type::way) {
+            way_nodes = rows.column_number("way_nodes");
+        } else if (type == osmium::item_type::relation) {
+            member_types = rows.column_number("member_types");
+            member_ids = rows.column_number("member_ids");
+            member_roles = rows.column_number("member_roles");
+        }
     }
+};
 
-    osmium::builder::WayNodeListBuilder wnbuilder{builder};
-    do {
-        wnbuilder.add_node_ref(it->node_ref);
-        ++it;
-    } while (it != end && it->way_id == id && it->version == version);
+// The add_*() functions below read the arrays from a row of the
+// aggregated queries.
 
-    return it;
+void add_tags(binary_row const &row, array_columns const &cols,
+              osmium::builder::Builder &builder)
+{
+    if (row.is_null(cols.tag_keys)) {
+        return;
+    }
+
+    pg_binary_array keys{row.get(cols.tag_keys), pg_binary_array::text_oid};
+    pg_binary_array values{row.get(cols.tag_values),
+                           pg_binary_array::text_oid};
+    if (keys.size() != values.size()) {
+        throw database_error{"Different number of tag keys and values"};
+    }
+
+    osmium::builder::TagListBuilder tbuilder{builder};
+    std::string_view key;
+    std::string_view value;
+    while (keys.next(&key) && values.next(&value)) {
+        tbuilder.add_tag(key.data(), key.size(), value.data(), value.size());
+    }
 }
 
-members_iterator add_members(members_iterator it, members_iterator end,
-                             osmium::object_id_type id,
-                             osmium::object_version_type version,
-                             osmium::builder::Builder &builder)
+void add_way_nodes(binary_row const &row, array_columns const &cols,
+                   osmium::builder::Builder &builder)
 {
-    if (it == end || it->relation_id != id || it->version != version) {
-        return it;
+    if (row.is_null(cols.way_nodes)) {
+        return;
     }
 
-    osmium::builder::RelationMemberListBuilder mbuilder{builder};
-    do {
-        mbuilder.add_member(it->mtype, it->mref, it->mrole);
-        ++it;
-    } while (it != end && it->relation_id == id && it->version == version);
+    pg_binary_array refs{row.get(cols.way_nodes), pg_binary_array::int8_oid};
 
-    return it;
+    osmium::builder::WayNodeListBuilder wnbuilder{builder};
+    std::int64_t ref = 0;
+    while (refs.next(&ref)) {
+        wnbuilder.add_node_ref(ref);
+    }
 }
 
-char const attr[] =
-    R"(, o.version, o.changeset_id, o.visible, to_char(o.timestamp, 'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp, o.redaction_id)";
+void add_members(binary_row const &row, array_columns const &cols,
+                 osmium::builder::Builder &builder)
+{
+    if (row.is_null(cols.member_types)) {
+        return;
+    }
 
-constexpr std::size_t const buffer_size = 1024UL * 1024UL;
+    pg_binary_array types{row.get(cols.member_types),
+                          pg_binary_array::text_oid};
+    pg_binary_array refs{row.get(cols.member_ids), pg_binary_array::int8_oid};
+    pg_binary_array roles{row.get(cols.member_roles),
+                          pg_binary_array::text_oid};
+    if (refs.size() != types.size() || roles.size() != types.size()) {
+        throw database_error{"Different number of member attributes"};
+    }
 
-template <typename TBuilder>
-void set_attributes(TBuilder &builder, changeset_user_lookup const &cucache,
-                    osmium::object_id_type id,
-                    osmium::object_version_type version,
-                    osmium::Timestamp timestamp,
-                    pqxx::result::const_iterator const &row)
-{
-    auto const cid = row["changeset_id"].as<osmium::changeset_id_type>();
-    bool const visible = row["visible"].c_str()[0] == 't';
-    auto const &user = cucache.at(cid);
-
-    builder.set_id(id)
-        .set_version(version)
-        .set_changeset(cid)
-        .set_visible(visible)
-        .set_uid(user.id)
-        .set_timestamp(timestamp)
-        .set_user(user.username);
+    osmium::builder::RelationMemberListBuilder mbuilder{builder};
+    std::string_view type;
+    std::int64_t ref = 0;
+    std::string_view role;
+    while (types.next(&type) && refs.next(&ref) && roles.next(&role)) {
+        if (type.empty()) {
+            throw database_error{"Empty member type"};
+        }
+        mbuilder.add_member(type_from_char(type.data()), ref, role.data(),
+                            role.size());
+    }
 }
 
-osmium::memory::Buffer process_nodes(pqxx::dbtransaction &txn,
-                                     changeset_user_lookup const &cucache,
-                                     std::vector<osmobj> const &objs,
-                                     osmium::Timestamp *max_timestamp)
+constexpr std::size_t const buffer_size = 1024UL * 1024UL;
+
+// Buffers are handed on when they are filled beyond this. Nearly all
+// objects fit into the rest, so buffers rarely have to grow.
+constexpr std::size_t const flush_size = buffer_size * 3UL / 4UL;
+
+/// The block of the change file an object is written into.
+enum class change_op
 {
-    std::string query = wanted(objs);
+    create,
+    modify,
+    remove
+};
 
-    auto const tags = get_tags(txn, "node", query);
+// This is how the XML writer decides on the block
+change_op op_for(bool visible, osmium::object_version_type version) noexcept
+{
+    if (!visible) {
+        return change_op::remove;
+    }
+    return version == 1 ? change_op::create : change_op::modify;
+}
 
-    query += "SELECT o.node_id";
-    query += attr;
-    query += ", o.longitude, o.latitude"
-             "  FROM nodes o"
-             "    INNER JOIN wanted w"
-             "      ON o.node_id = w.id AND o.version = w.version"
-             "  ORDER BY w.id, w.version";
+/// Objects of one type with the operations of the first and last object.
+struct change_buffer
+{
+    osmium::memory::Buffer buffer;
+    osmium::item_type type;
+    change_op first_op;
+    change_op last_op;
+};
+
+/// Receives the buffers with the objects in order.
+using flush_func = std::function<void(change_buffer &&)>;
+
+/**
+ * Buffer for the objects read from the database. When it is full enough
+ * it is handed to the flush function and a new buffer is started, so the
+ * writer can compress the objects while more are read.
+ *
+ * The XML writer closes the create, modify, or delete block at the end of
+ * each buffer. So a buffer is only handed on before an object with a
+ * different operation than the one before, a long run of objects with the
+ * same operation makes the buffer grow.
+ */
+class output_buffer
+{
+public:
+    output_buffer(osmium::item_type type, flush_func const &flush)
+    : m_flush(flush), m_type(type)
+    {
+    }
 
-    pqxx::result const result = txn.exec(query);
+    /// Call before building an object with the operation op.
+    void start_object(change_op op)
+    {
+        if (op != m_last_op && m_buffer.committed() >= flush_size) {
+            flush();
+        }
+        if (m_buffer.committed() == 0) {
+            m_first_op = op;
+        }
+        m_last_op = op;
+    }
 
-    osmium::memory::Buffer buffer{buffer_size};
+    [[nodiscard]] osmium::memory::Buffer &buffer() noexcept
+    {
+        return m_buffer;
+    }
 
-    auto it = tags.begin();
-    for (auto const &row : result) {
-        auto const id = row["node_id"].as<osmium::object_id_type>();
-        auto const version = row["version"].as<osmium::object_version_type>();
-        auto const timestamp = osmium::Timestamp{row["timestamp"].c_str()};
+    /// Commit the object just built.
+    void commit() { m_buffer.commit(); }
 
-        if (timestamp > *max_timestamp) {
-            *max_timestamp = timestamp;
+    /// Hand on the buffer if it contains any objects.
+    void flush()
+    {
+        if (m_buffer.committed() > 0) {
+            m_flush({std::move(m_buffer), m_type, m_first_op, m_last_op});
+            m_buffer = osmium::memory::Buffer{buffer_size};
         }
+    }
+
+private:
+    flush_func const &m_flush;
+    osmium::memory::Buffer m_buffer{buffer_size};
+    osmium::item_type m_type;
+    change_op m_first_op = change_op::create;
+    change_op m_last_op = change_op::create;
+
+}; // class output_buffer
+
+/**
+ * Hands the buffers to the writer in order. Batches end in the middle of
+ * a block, so a buffer is kept back until the next one is known. If that
+ * continues the block, it is appended to the buffer kept back. This way
+ * the change file is the same as with all objects of a type in one
+ * buffer.
+ */
+class change_writer
+{
+public:
+    explicit change_writer(osmium::io::Writer *writer) : m_writer(writer) {}
 
-        if (!row["redaction_id"].is_null()) {
-            std::cerr << "Ignored redacted node " << id << " version "
-                      << version
-                      << " (redaction_id=" << row["redaction_id"].c_str()
-                      << ")\n";
-            continue;
+    void add(change_buffer &&buffer)
+    {
+        if (m_pending && m_pending->type == buffer.type &&
+            m_pending->last_op == buffer.first_op) {
+            m_pending->buffer.add_buffer(buffer.buffer);
+            m_pending->buffer.commit();
+            m_pending->last_op = buffer.last_op;
+            return;
         }
 
-        osmium::Location const loc{row["longitude"].as<int64_t>(),
-                                   row["latitude"].as<int64_t>()};
+        flush();
+        m_pending = std::move(buffer);
+    }
 
-        {
-            osmium::builder::NodeBuilder builder{buffer};
-            builder.set_location(loc);
-            set_attributes(builder, cucache, id, version, timestamp, row);
-            it = add_tags(it, tags.end(), id, version, builder);
+    /// Write the buffer kept back.
+    void flush()
+    {
+        if (m_pending) {
+            (*m_writer)(std::move(m_pending->buffer));
+            m_pending.reset();
         }
-        buffer.commit();
     }
 
-    return buffer;
-}
+private:
+    osmium::io::Writer *m_writer;
+    std::optional<change_buffer> m_pending;
 
-osmium::memory::Buffer process_ways(pqxx::dbtransaction &txn,
-                                    changeset_user_lookup const &cucache,
-                                    std::vector<osmobj> const &objs,
-                                    osmium::Timestamp *max_timestamp)
-{
-    std::string query = wanted(objs);
+}; // class change_writer
 
-    auto const tags = get_tags(txn, "way", query);
-    auto const way_nodes = get_nodes(txn, query);
+/// Everything one thread needs to read objects from the database.
+struct fetch_context
+{
+    pqxx::dbtransaction *txn;
+    pq::connection *binary_db; // for queries in binary format
+    changeset_user_lookup const *cucache;
+    query_mode mode;
+};
 
-    query += "SELECT o.way_id";
-    query += attr;
-    query += "  FROM ways o"
-             "    INNER JOIN wanted w"
-             "      ON o.way_id = w.id AND o.version = w.version"
-             "  ORDER BY w.id, w.version";
+/**
+ * Build the object in the row with a builder of type TBuilder unless it
+ * is redacted. The function add_details(builder, id, version) adds the
+ * location, tags, way nodes, or members.
+ */
+template <typename TBuilder, typename TColumns, typename TRow,
+          typename TFunc>
+void build_object(char const *type, TColumns const &cols, TRow const &row,
+                  changeset_user_lookup const &cucache,
+                  osmium::Timestamp *max_timestamp, output_buffer *out,
+                  TFunc &&add_details)
+{
+    auto const id = cols.id(row);
+    auto const version = cols.version(row);
+    auto const timestamp = cols.timestamp(row);
 
-    pqxx::result const result = txn.exec(query);
+    if (timestamp > *max_timestamp) {
+        *max_timestamp = timestamp;
+    }
 
-    osmium::memory::Buffer buffer{buffer_size};
+    if (cols.is_redacted(row)) {
+        std::cerr << "Ignored redacted " << type << ' ' << id << " version "
+                  << version << " (redaction_id=" << cols.redaction_id(row)
+                  << ")\n";
+        return;
+    }
 
-    auto it = tags.begin();
-    auto wn_it = way_nodes.begin();
-    for (auto const &row : result) {
-        auto const id = row["way_id"].as<osmium::object_id_type>();
-        auto const version = row["version"].as<osmium::object_version_type>();
-        auto const timestamp = osmium::Timestamp{row["timestamp"].c_str()};
+    out->start_object(op_for(cols.visible(row), version));
+    {
+        TBuilder builder{out->buffer()};
+        cols.set_attributes(builder, row, cucache, id, version, timestamp);
+        add_details(builder, id, version);
+    }
+    out->commit();
+}
 
-        if (timestamp > *max_timestamp) {
-            *max_timestamp = timestamp;
+void process_nodes(fetch_context const &ctx, objs_iterator first,
+                   objs_iterator last, osmium::Timestamp *max_timestamp,
+                   flush_func const &flush)
+{
+    using builder_type = osmium::builder::NodeBuilder;
+    auto const &cucache = *ctx.cucache;
+    wanted const params{first, last};
+    output_buffer out{osmium::item_type::node, flush};
+
+    if (ctx.mode == query_mode::aggregate) {
+        pq::row_stream rows{ctx.binary_db, aggregated_query("node"),
+                            {params.ids, params.versions}};
+        node_columns<binary_row> const cols{rows};
+        array_columns const arrays{rows, osmium::item_type::node};
+        for (; !rows.at_end(); rows.next()) {
+            binary_row const row{rows};
+            build_object<builder_type>(
+                "node", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type,
+                    osmium::object_version_type) {
+                    builder.set_location(cols.location(row));
+                    add_tags(row, arrays, builder);
+                });
         }
+    } else {
+        child_stream<pq::row_stream> tags{ctx.binary_db, tags_query("node"),
+                                          params};
+        pqxx::result const result = exec_wanted(*ctx.txn, "nodes", params);
+        node_columns<pqxx::row> const cols{result};
+        for (auto const &row : result) {
+            build_object<builder_type>(
+                "node", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type id,
+                    osmium::object_version_type version) {
+                    builder.set_location(cols.location(row));
+                    add_tags(&tags, id, version, builder);
+                });
+        }
+    }
 
-        if (!row["redaction_id"].is_null()) {
-            std::cerr << "Ignored redacted way " << id << " version " << version
-                      << " (redaction_id=" << row["redaction_id"].c_str()
-                      << ")\n";
-            continue;
+    out.flush();
+}
+
+void process_ways(fetch_context const &ctx, objs_iterator first,
+                  objs_iterator last, osmium::Timestamp *max_timestamp,
+                  flush_func const &flush)
+{
+    using builder_type = osmium::builder::WayBuilder;
+    auto const &cucache = *ctx.cucache;
+    wanted const params{first, last};
+    output_buffer out{osmium::item_type::way, flush};
+
+    if (ctx.mode == query_mode::aggregate) {
+        pq::row_stream rows{ctx.binary_db, aggregated_query("way"),
+                            {params.ids, params.versions}};
+        object_columns<binary_row> const cols{rows, "way_id"};
+        array_columns const arrays{rows, osmium::item_type::way};
+        for (; !rows.at_end(); rows.next()) {
+            binary_row const row{rows};
+            build_object<builder_type>(
+                "way", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type,
+                    osmium::object_version_type) {
+                    add_tags(row, arrays, builder);
+                    add_way_nodes(row, arrays, builder);
+                });
+        }
+    } else {
+        child_stream<pq::cursor> tags{ctx.binary_db, "tags", tags_query("way"),
+                                      params};
+        child_stream<pq::cursor> way_nodes{ctx.binary_db, "way_nodes",
+                                           way_nodes_query, params};
+        pqxx::result const result = exec_wanted(*ctx.txn, "ways", params);
+        object_columns<pqxx::row> const cols{result, "way_id"};
+        for (auto const &row : result) {
+            build_object<builder_type>(
+                "way", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type id,
+                    osmium::object_version_type version) {
+                    add_tags(&tags, id, version, builder);
+                    add_way_nodes(&way_nodes, id, version, builder);
+                });
         }
+    }
+
+    out.flush();
+}
 
-        {
-            osmium::builder::WayBuilder builder{buffer};
-            set_attributes(builder, cucache, id, version, timestamp, row);
-            it = add_tags(it, tags.end(), id, version, builder);
-            wn_it = add_way_nodes(wn_it, way_nodes.end(), id, version, builder);
+void process_relations(fetch_context const &ctx, objs_iterator first,
+                       objs_iterator last, osmium::Timestamp *max_timestamp,
+                       flush_func const &flush)
+{
+    using builder_type = osmium::builder::RelationBuilder;
+    auto const &cucache = *ctx.cucache;
+    wanted const params{first, last};
+    output_buffer out{osmium::item_type::relation, flush};
+
+    if (ctx.mode == query_mode::aggregate) {
+        pq::row_stream rows{ctx.binary_db, aggregated_query("relation"),
+                            {params.ids, params.versions}};
+        object_columns<binary_row> const cols{rows, "relation_id"};
+        array_columns const arrays{rows, osmium::item_type::relation};
+        for (; !rows.at_end(); rows.next()) {
+            binary_row const row{rows};
+            build_object<builder_type>(
+                "relation", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type,
+                    osmium::object_version_type) {
+                    add_tags(row, arrays, builder);
+                    add_members(row, arrays, builder);
+                });
+        }
+    } else {
+        child_stream<pq::cursor> tags{ctx.binary_db, "tags",
+                                      tags_query("relation"), params};
+        child_stream<pq::cursor> members{ctx.binary_db, "members",
+                                         members_query, params};
+        pqxx::result const result =
+            exec_wanted(*ctx.txn, "relations", params);
+        object_columns<pqxx::row> const cols{result, "relation_id"};
+        for (auto const &row : result) {
+            build_object<builder_type>(
+                "relation", cols, row, cucache, max_timestamp, &out,
+                [&](builder_type &builder, osmium::object_id_type id,
+                    osmium::object_version_type version) {
+                    add_tags(&tags, id, version, builder);
+                    add_members(&members, id, version, builder);
+                });
         }
-        buffer.commit();
     }
 
-    return buffer;
+    out.flush();
 }
 
-osmium::memory::Buffer process_relations(pqxx::dbtransaction &txn,
-                                         changeset_user_lookup const &cucache,
-                                         std::vector<osmobj> const &objs,
-                                         osmium::Timestamp *max_timestamp)
+using process_func = void (*)(fetch_context const &, objs_iterator,
+                              objs_iterator, osmium::Timestamp *,
+                              flush_func const &);
+
+/// Objects of one type read from the database and written out together.
+struct batch
 {
-    std::string query = wanted(objs);
+    process_func process;
+    objs_iterator first;
+    objs_iterator last;
+};
 
-    auto const tags = get_tags(txn, "relation", query);
-    auto const members = get_members(txn, query);
+/**
+ * Split the objects into batches of at most batch_size objects, so that
+ * the memory needed doesn't depend on the number of objects. Batches are
+ * made smaller if needed to give all threads something to do. The
+ * objects are sorted, so writing out the batches in order gives the same
+ * objects in the same order as reading them all at once.
+ */
+std::vector<batch> make_batches(osmobjects const &objects,
+                                std::size_t batch_size, unsigned int threads)
+{
+    std::vector<batch> batches;
+
+    auto const add = [&](std::vector<osmobj> const &objs,
+                         process_func process) {
+        auto const size = std::min(
+            batch_size, std::max<std::size_t>(
+                            (objs.size() + threads - 1) / threads, 1));
+        auto it = objs.begin();
+        while (it != objs.end()) {
+            auto const count =
+                std::min(size, static_cast<std::size_t>(objs.end() - it));
+            batches.push_back({process, it, it + count});
+            it += count;
+        }
+    };
 
-    query += "SELECT o.relation_id";
-    query += attr;
-    query += "  FROM relations o"
-             "    INNER JOIN wanted w"
-             "      ON o.relation_id = w.id AND o.version = w.version"
-             "  ORDER BY w.id, w.version";
+    add(objects.nodes(), process_nodes);
+    add(objects.ways(), process_ways);
+    add(objects.relations(), process_relations);
 
-    pqxx::result const result = txn.exec(query);
+    return batches;
+}
 
-    osmium::memory::Buffer buffer{buffer_size};
+/// All objects are read in transactions of this type.
+using snapshot_transaction =
+    pqxx::transaction<pqxx::isolation_level::repeatable_read,
+                      pqxx::write_policy::read_only>;
 
-    auto it = tags.begin();
-    auto member_it = members.begin();
-    for (auto const &row : result) {
-        auto const id = row["relation_id"].as<osmium::object_id_type>();
-        auto const version = row["version"].as<osmium::object_version_type>();
-        auto const timestamp = osmium::Timestamp{row["timestamp"].c_str()};
+/// Start a transaction on the connection like a snapshot_transaction.
+void begin_transaction(pq::connection *db)
+{
+    db->exec("BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY",
+             PGRES_COMMAND_OK);
+}
 
-        if (timestamp > *max_timestamp) {
-            *max_timestamp = timestamp;
-        }
+/// Start a transaction on the connection using the exported snapshot.
+void import_snapshot(pq::connection *db, std::string const &snapshot)
+{
+    begin_transaction(db);
+    // Snapshot ids only contain hex digits and dashes
+    db->exec("SET TRANSACTION SNAPSHOT '" + snapshot + "'", PGRES_COMMAND_OK);
+}
 
-        if (!row["redaction_id"].is_null()) {
-            std::cerr << "Ignored redacted relation " << id << " version "
-                      << version
-                      << " (redaction_id=" << row["redaction_id"].c_str()
-                      << ")\n";
-            continue;
-        }
+/**
+ * Additional database connections used by a worker thread. Their
+ * transactions import the snapshot exported by the main transaction, so
+ * they see exactly the same data.
+ */
+class fetch_connection
+{
+public:
+    fetch_connection(std::string const &connection_params,
+                     std::string const &snapshot)
+    : m_db(connection_params), m_binary_db(connection_params)
+    {
+        prepare_queries(m_db);
+        m_txn.emplace(m_db);
+        m_txn->exec("SET TRANSACTION SNAPSHOT " + m_txn->quote(snapshot));
+        import_snapshot(&m_binary_db, snapshot);
+    }
 
-        {
-            osmium::builder::RelationBuilder builder{buffer};
-            set_attributes(builder, cucache, id, version, timestamp, row);
-            it = add_tags(it, tags.end(), id, version, builder);
-            member_it =
-                add_members(member_it, members.end(), id, version, builder);
-        }
-        buffer.commit();
+    [[nodiscard]] fetch_context context(changeset_user_lookup const &cucache,
+                                        query_mode mode) noexcept
+    {
+        return {&*m_txn, &m_binary_db, &cucache, mode};
     }
 
-    return buffer;
-}
+private:
+    pqxx::connection m_db;
+    pq::connection m_binary_db;
+    std::optional<snapshot_transaction> m_txn;
+
+}; // class fetch_connection
+
+struct batch_result
+{
+    std::vector<change_buffer> buffers;
+    osmium::Timestamp max_timestamp{};
+};
 
-static void write_to(osmium::memory::Buffer &buffer, osmium::io::Writer &w)
+/**
+ * Read the batches on several connections in parallel and write them out
+ * in order. At most two batches per thread are in memory at any time.
+ */
+void fetch_in_parallel(Config const &config, std::string const &snapshot,
+                       unsigned int threads,
+                       changeset_user_lookup const &cucache, query_mode mode,
+                       std::vector<batch> const &batches,
+                       osmium::Timestamp *max_timestamp,
+                       change_writer *writer)
 {
-    w(std::move(buffer));
+    std::vector<std::unique_ptr<fetch_connection>> connections;
+    for (unsigned int i = 0; i < threads; ++i) {
+        connections.push_back(std::make_unique<fetch_connection>(
+            config.db_connection(), snapshot));
+    }
+
+    using task_type = std::packaged_task<batch_result(fetch_context const &)>;
+    bounded_queue<task_type> tasks{threads};
+    std::deque<std::future<batch_result>> pending;
+    std::vector<std::future<void>> workers;
+
+    // Declared after the workers, so the queue is closed before waiting
+    // for them, also on exceptions
+    queue_closer<task_type> const closer{&tasks};
+
+    for (auto &connection : connections) {
+        workers.push_back(std::async(
+            std::launch::async,
+            [&tasks, ctx = connection->context(cucache, mode)] {
+                while (auto task = tasks.pop()) {
+                    (*task)(ctx);
+                }
+            }));
+    }
+
+    auto const write_oldest = [&] {
+        auto result = pending.front().get();
+        pending.pop_front();
+        if (result.max_timestamp > *max_timestamp) {
+            *max_timestamp = result.max_timestamp;
+        }
+        for (auto &buffer : result.buffers) {
+            writer->add(std::move(buffer));
+        }
+    };
+
+    for (auto const &b : batches) {
+        if (pending.size() >= 2UL * threads) {
+            write_oldest();
+        }
+        task_type task{[b](fetch_context const &ctx) {
+            batch_result result;
+            flush_func const collect = [&result](change_buffer &&buffer) {
+                result.buffers.push_back(std::move(buffer));
+            };
+            b.process(ctx, b.first, b.last, &result.max_timestamp, collect);
+            return result;
+        }};
+        pending.push_back(task.get_future());
+        tasks.push(std::move(task));
+    }
+
+    while (!pending.empty()) {
+        write_oldest();
+    }
 }
 
 bool app(osmium::VerboseOutput &vout, Config const &config,
@@ -575,8 +1221,9 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
                 "directory...\n";
         std::filesystem::path const p{config.log_dir()};
         for (auto const &file : std::filesystem::directory_iterator(p)) {
-            if (file.path().extension() == ".log") {
-                log_files.push_back(file.path().filename().string());
+            auto name = file.path().filename().string();
+            if (is_log_file_name(name)) {
+                log_files.push_back(std::move(name));
             }
         }
     }
@@ -594,8 +1241,12 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
 
     vout << "Connecting to database...\n";
     pqxx::connection db{config.db_connection()};
+    prepare_queries(db);
+
+    // All queries, also those from other fetch connections using the
+    // exported snapshot, see the same state of the database.
+    snapshot_transaction txn{db};
 
-    pqxx::read_transaction txn{db};
     vout << "Database version: " << get_db_version(txn) << '\n';
 
     osmobjects objects_todo;
@@ -625,7 +1276,14 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
     objects_todo.sort();
 
     vout << "Populating changeset cache...\n";
-    populate_changeset_cache(txn, cucache);
+    auto const cache_file_name = config.run_dir() + "osmdbt-changeset-cache";
+    changeset_cache cscache;
+    try {
+        cscache = changeset_cache{cache_file_name};
+    } catch (std::runtime_error const &e) {
+        vout << "  Ignoring changeset cache: " << e.what() << '\n';
+    }
+    populate_changeset_cache(vout, txn, cscache, cucache);
     vout << "  Got " << cucache.size() << " changesets.\n";
 
     auto const new_change_file_name = config.tmp_dir() + "new-change.osc";
@@ -647,24 +1305,37 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
     // we have seen. This will later end up in the state file.
     osmium::Timestamp max_timestamp{};
 
-    if (!objects_todo.nodes().empty()) {
-        auto buffer =
-            process_nodes(txn, cucache, objects_todo.nodes(), &max_timestamp);
-
-        write_to(buffer, writer_xml);
-    }
-    if (!objects_todo.ways().empty()) {
-        auto buffer =
-            process_ways(txn, cucache, objects_todo.ways(), &max_timestamp);
-
-        write_to(buffer, writer_xml);
-    }
-    if (!objects_todo.relations().empty()) {
-        auto buffer = process_relations(txn, cucache, objects_todo.relations(),
-                                        &max_timestamp);
-
-        write_to(buffer, writer_xml);
+    auto const batches = make_batches(objects_todo, options.batch_size(),
+                                      options.fetch_threads());
+
+    change_writer writer{&writer_xml};
+    if (options.fetch_threads() > 1) {
+        // Other connections import this snapshot to see the same data
+        auto const snapshot =
+            txn.exec("SELECT pg_export_snapshot()")[0][0].as<std::string>();
+        vout << "Reading " << batches.size() << " batches on "
+             << options.fetch_threads() << " connections...\n";
+        fetch_in_parallel(config, snapshot, options.fetch_threads(), cucache,
+                          options.query_mode(), batches, &max_timestamp,
+                          &writer);
+    } else {
+        // The versions of objects asked for and their tags, nodes, and
+        // members never change, so the connection for the binary queries
+        // doesn't need the snapshot of the main transaction.
+        pq::connection binary_db{config.db_connection()};
+        begin_transaction(&binary_db);
+        fetch_context const ctx{&txn, &binary_db, &cucache,
+                                options.query_mode()};
+        // The writer compresses and writes the buffers in its own threads
+        // while the next objects are read
+        flush_func const write = [&writer](change_buffer &&buffer) {
+            writer.add(std::move(buffer));
+        };
+        for (auto const &b : batches) {
+            b.process(ctx, b.first, b.last, &max_timestamp, write);
+        }
     }
+    writer.flush();
 
     txn.commit();
     writer_xml.close();
@@ -718,6 +1389,16 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
 
         ::unlink(lock_file_path.c_str());
         sync_dir(config.tmp_dir());
+
+        // The change file is already published, a missing cache only
+        // makes the next run slower.
+        vout << "Writing changeset cache '" << cache_file_name << "'...\n";
+        try {
+            changeset_cache::write(cache_file_name, cucache);
+        } catch (std::exception const &e) {
+            std::cerr << "Warning: Could not write changeset cache: "
+                      << e.what() << '\n';
+        }
     }
 
     vout << "All done.\n";
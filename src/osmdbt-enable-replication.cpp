@@ -6,6 +6,8 @@
 
 #include <osmium/util/verbose_output.hpp>
 
+#include <string>
+
 namespace {
 
 class EnableReplicationOptions : public Options
@@ -31,9 +33,22 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
 
         vout << "Database version: " << get_db_version(txn) << '\n';
 
-        txn.exec(
-            "CREATE PUBLICATION " + config.publication() +
-            " FOR TABLE ONLY nodes, ways, relations;"); // TODO: table names as config option
+        // TODO: table names as config option
+        std::string query{"CREATE PUBLICATION " + config.publication()};
+        if (db.server_version() >= 150000) {
+            // Only publish the columns we need, so the other columns are
+            // not decoded and sent.
+            query += " FOR TABLE ONLY"
+                     " nodes (node_id, version, changeset_id, redaction_id),"
+                     " ways (way_id, version, changeset_id, redaction_id),"
+                     " relations (relation_id, version, changeset_id,"
+                     " redaction_id)";
+        } else {
+            query += " FOR TABLE ONLY nodes, ways, relations";
+        }
+        query += " WITH (publish = 'insert, update');";
+
+        txn.exec(query);
         txn.commit();
         vout << "Publication created.\n";
     }
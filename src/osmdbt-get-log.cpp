@@ -1,52 +1,29 @@
-
+#include "batch.hpp"
+#include "binlog.hpp"
+#include "compression.hpp"
 #include "config.hpp"
 #include "db.hpp"
 #include "io.hpp"
 #include "lsn.hpp"
 #include "options.hpp"
 #include "pgoutput.hpp"
+#include "pipeline.hpp"
+#include "pq.hpp"
+#include "replication.hpp"
 #include "util.hpp"
 
 #include <osmium/util/verbose_output.hpp>
 
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
 #include <iterator>
+#include <limits>
 #include <string>
-
-namespace {
-
-std::string_view psql_field_to_string_view(const pqxx::field& field) {
-  return {field.c_str(), field.size()};
-}
-
-std::vector<char> hex2bytes(std::string_view hex)
-{
-    std::vector<char> bytes;
-
-    if (hex.empty())
-      return bytes;
-
-    bytes.reserve(hex.size() / 2);
-
-    // mapping of ASCII characters to hex values
-    constexpr uint8_t hashmap[] = {
-        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, // 01234567
-        0x08, 0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // 89:;<=>?
-        0x00, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x00, // @ABCDEFG
-        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // HIJKLMNO
-    };
-
-    for (decltype(hex.size()) pos = 0; pos < hex.size(); pos += 2) {
-        uint8_t idx0 = (hex[pos + 0] & 0x1F) ^ 0x10;
-        uint8_t idx1 = (hex[pos + 1] & 0x1F) ^ 0x10;
-        bytes.push_back((hashmap[idx0] << 4) | hashmap[idx1]);
-    };
-
-    return bytes;
-}
-
-} // namespace
+#include <string_view>
 
 class GetLogOptions : public Options
 {
@@ -59,11 +36,58 @@ public:
 
     [[nodiscard]] bool real_state() const noexcept { return m_real_state; }
 
+    [[nodiscard]] bool follow() const noexcept { return m_follow; }
+
+    [[nodiscard]] bool streaming() const noexcept { return m_streaming; }
+
+    [[nodiscard]] bool binary() const noexcept { return m_binary; }
+
+    /// Write logs in binary format instead of text format.
+    [[nodiscard]] bool binary_log() const noexcept { return m_binary_log; }
+
+    [[nodiscard]] compression_type compression() const noexcept
+    {
+        return m_compression;
+    }
+
+    [[nodiscard]] bool single_threaded() const noexcept
+    {
+        return m_single_threaded;
+    }
+
+    [[nodiscard]] unsigned int decode_threads() const noexcept
+    {
+        return m_decode_threads;
+    }
+
     [[nodiscard]] uint32_t max_changes() const noexcept
     {
         return m_max_changes;
     }
 
+    /// Keep reading batches of changes for this long (0: read one batch).
+    [[nodiscard]] std::chrono::seconds time_budget() const noexcept
+    {
+        return m_time_budget;
+    }
+
+    /// Number of changes in the first batch with --time-budget.
+    [[nodiscard]] uint32_t batch_changes() const noexcept
+    {
+        return m_batch_changes;
+    }
+
+    [[nodiscard]] std::chrono::seconds batch_time() const noexcept
+    {
+        return m_batch_time;
+    }
+
+    /// Maximum size of log data kept in memory in bytes.
+    [[nodiscard]] std::size_t buffer_size() const noexcept
+    {
+        return static_cast<std::size_t>(m_buffer_size) * 1024UL * 1024UL;
+    }
+
 private:
     void add_command_options(po::options_description &desc) override
     {
@@ -73,7 +97,18 @@ private:
         opts_cmd.add_options()
             ("catchup", "Commit changes when they have been logged successfully")
             ("real-state,s", "Show real state (LSN and xid) instead of '0/0 0'")
-            ("max-changes,m", po::value<uint32_t>(), "Maximum number of changes (default: no limit)");
+            ("follow", "Keep running and stream changes from the replication slot")
+            ("streaming", "Get large transactions while they are in progress (needs PostgreSQL 14+)")
+            ("binary", "Get column data in binary format (needs PostgreSQL 14+)")
+            ("log-format", po::value<std::string>(), "Format of log files: 'text' (default) or 'binary'")
+            ("compression", po::value<std::string>(), "Compress text log files: 'none' (default), 'gzip', or 'zstd'")
+            ("single-threaded", "Fetch, decode, and write changes in one thread")
+            ("decode-threads", po::value<unsigned int>(), "Number of threads for decoding changes (default: 1)")
+            ("max-changes,m", po::value<uint32_t>(), "Maximum number of changes, in all batches together with --time-budget (default: no limit)")
+            ("time-budget,t", po::value<uint32_t>(), "Keep reading batches of changes for up to this many seconds (needs --catchup)")
+            ("batch-changes", po::value<uint32_t>(), "Number of changes in the first batch (default: 10000)")
+            ("batch-time", po::value<uint32_t>(), "Target time for one batch in seconds (default: 10)")
+            ("buffer-size,b", po::value<uint32_t>(), "Write log data to disk when it reaches this size in MBytes (default: 64)");
         // clang-format on
 
         desc.add(opts_cmd);
@@ -90,152 +125,546 @@ private:
         if (vm.count("max-changes")) {
             m_max_changes = vm["max-changes"].as<uint32_t>();
         }
+        if (vm.count("buffer-size")) {
+            m_buffer_size = vm["buffer-size"].as<uint32_t>();
+            if (m_buffer_size == 0) {
+                throw argument_error{"--buffer-size must be at least 1"};
+            }
+        }
+        if (vm.count("streaming")) {
+            m_streaming = true;
+        }
+        if (vm.count("binary")) {
+            m_binary = true;
+        }
+        if (vm.count("log-format")) {
+            auto const &format = vm["log-format"].as<std::string>();
+            if (format == "binary") {
+                m_binary_log = true;
+            } else if (format != "text") {
+                throw argument_error{
+                    "--log-format must be 'text' or 'binary'"};
+            }
+        }
+        if (vm.count("compression")) {
+            auto const &type = vm["compression"].as<std::string>();
+            if (type == "gzip") {
+                m_compression = compression_type::gzip;
+            } else if (type == "zstd") {
+                m_compression = compression_type::zstd;
+            } else if (type != "none") {
+                throw argument_error{
+                    "--compression must be 'none', 'gzip', or 'zstd'"};
+            }
+            if (!compression_available(m_compression)) {
+                throw argument_error{
+                    "osmdbt was compiled without zstd support"};
+            }
+            if (m_compression != compression_type::none && m_binary_log) {
+                throw argument_error{
+                    "Can not use --compression with --log-format=binary"};
+            }
+        }
+        if (vm.count("single-threaded")) {
+            m_single_threaded = true;
+        }
+        if (vm.count("decode-threads")) {
+            m_decode_threads = vm["decode-threads"].as<unsigned int>();
+            if (m_decode_threads == 0) {
+                throw argument_error{"--decode-threads must be at least 1"};
+            }
+            if (m_decode_threads > 1 && m_single_threaded) {
+                throw argument_error{"Can not use --decode-threads together "
+                                     "with --single-threaded"};
+            }
+            if (m_decode_threads > 1 && m_streaming) {
+                throw argument_error{
+                    "Can not use --decode-threads together with --streaming"};
+            }
+        }
+        if (vm.count("time-budget")) {
+            m_time_budget =
+                std::chrono::seconds{vm["time-budget"].as<uint32_t>()};
+            if (m_time_budget.count() == 0) {
+                throw argument_error{"--time-budget must be at least 1"};
+            }
+            if (!m_catchup) {
+                throw argument_error{"--time-budget needs --catchup"};
+            }
+        }
+        if (vm.count("batch-time")) {
+            m_batch_time = std::chrono::seconds{vm["batch-time"].as<uint32_t>()};
+            if (m_batch_time.count() == 0) {
+                throw argument_error{"--batch-time must be at least 1"};
+            }
+        }
+        if (vm.count("batch-changes")) {
+            m_batch_changes = vm["batch-changes"].as<uint32_t>();
+            if (m_batch_changes == 0) {
+                throw argument_error{"--batch-changes must be at least 1"};
+            }
+        }
+        if ((vm.count("batch-changes") || vm.count("batch-time")) &&
+            m_time_budget.count() == 0) {
+            throw argument_error{
+                "--batch-changes and --batch-time need --time-budget"};
+        }
+        if (vm.count("follow")) {
+            if (m_time_budget.count() > 0) {
+                throw argument_error{
+                    "Can not use --time-budget together with --follow"};
+            }
+            if (m_max_changes > 0) {
+                throw argument_error{
+                    "Can not use --max-changes together with --follow"};
+            }
+            if (m_single_threaded) {
+                throw argument_error{
+                    "Can not use --single-threaded together with --follow"};
+            }
+            if (m_decode_threads > 1) {
+                throw argument_error{
+                    "Can not use --decode-threads together with --follow"};
+            }
+            m_follow = true;
+        }
     }
 
     std::uint32_t m_max_changes = 0;
+    std::uint32_t m_buffer_size = 64;
+    std::uint32_t m_batch_changes = 10000;
+    std::chrono::seconds m_time_budget{0};
+    std::chrono::seconds m_batch_time{10};
+    unsigned int m_decode_threads = 1;
+    compression_type m_compression = compression_type::none;
     bool m_catchup = false;
     bool m_real_state = false;
+    bool m_follow = false;
+    bool m_streaming = false;
+    bool m_binary = false;
+    bool m_binary_log = false;
+    bool m_single_threaded = false;
 }; // class GetLogOptions
 
-bool app(osmium::VerboseOutput &vout, Config const &config,
-         GetLogOptions const &options)
+namespace {
+
+// How long to wait for new messages before writing out what we have.
+constexpr std::chrono::milliseconds const stream_idle_timeout{100};
+
+// Write out committed changes at least this often while data is streaming.
+constexpr std::chrono::milliseconds const stream_flush_interval{1000};
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+volatile std::sig_atomic_t stop_requested = 0;
+
+void handle_stop_signal(int /*signal*/) { stop_requested = 1; }
+
+// Options for the pgoutput plugin except for the publication names
+plugin_options get_plugin_options(GetLogOptions const &options)
 {
-    // All commands writing log files and/or advancing the replication slot
-    // use the same pid/lock file.
-    PIDFile const pid_file{config.run_dir(), "osmdbt-log"};
+    plugin_options result{{"proto_version", options.streaming() ? "2" : "1"}};
+    if (options.streaming()) {
+        result.emplace_back("streaming", "on");
+    }
+    if (options.binary()) {
+        result.emplace_back("binary", "true");
+    }
+    return result;
+}
 
-    vout << "Connecting to database...\n";
-    pqxx::connection db{config.db_connection()};
+void check_server_version(int version, GetLogOptions const &options)
+{
+    if ((options.streaming() || options.binary()) && version < 140000) {
+        throw database_error{
+            "--streaming and --binary need PostgreSQL 14 or above"};
+    }
+}
 
-    std::string select{"SELECT lsn, xid, encode(data, 'hex') as data FROM "
-                       "pg_logical_slot_peek_binary_changes($1, NULL, "};
-    if (options.max_changes() > 0) {
-        vout << "Reading up to " << options.max_changes()
-             << " changes (change with --max-changes)\n";
-        select += std::to_string(options.max_changes());
+std::string log_file_name(std::string const &lsn, GetLogOptions const &options)
+{
+    std::string lsn_dash{"lsn-"};
+    std::transform(lsn.cbegin(), lsn.cend(), std::back_inserter(lsn_dash),
+                   [](char c) { return c == '/' ? '-' : c; });
+
+    if (options.binary_log()) {
+        return create_replication_log_name(lsn_dash, std::time(nullptr),
+                                           blog::extension);
+    }
+
+    std::string const extension =
+        std::string{".log"} + compression_suffix(options.compression());
+    return create_replication_log_name(lsn_dash, std::time(nullptr),
+                                       extension.c_str());
+}
+
+// Binary logs are built from records directly
+pgoutput::log_format builder_format(GetLogOptions const &options) noexcept
+{
+    return options.binary_log() ? pgoutput::log_format::records
+                                : pgoutput::log_format::text;
+}
+
+void write_log(osmium::VerboseOutput &vout, Config const &config,
+               GetLogOptions const &options, std::string_view data,
+               std::string const &lsn)
+{
+    std::string const file_name = log_file_name(lsn, options);
+    vout << "Writing log to '" << config.log_dir() << file_name << "'...\n";
+
+    if (options.binary_log()) {
+        write_data_to_file(blog::file_data(data), config.log_dir(),
+                           file_name);
     } else {
-        vout << "Reading any number of changes (change with --max-changes)\n";
-        select += "NULL";
+        write_data_to_file(data, config.log_dir(), file_name,
+                           options.compression());
     }
-    select += ", 'proto_version', '1'";
-    select += ", 'publication_names', $2);";
+    vout << "Wrote and synced log.\n";
+}
 
-    db.prepare("peek", select);
+void flush_stream_log(osmium::VerboseOutput &vout, Config const &config,
+                      GetLogOptions const &options,
+                      pgoutput::log_builder *builder,
+                      replication_stream *stream)
+{
+    if (!builder->has_commits()) {
+        return;
+    }
 
-    std::string lsn;
+    if (builder->has_actual_data()) {
+        write_log(vout, config, options, builder->committed_data(),
+                  builder->lsn());
+    }
 
-    {
-        pqxx::read_transaction txn{db};
-        vout << "Database version: " << get_db_version(txn) << '\n';
+    if (options.catchup()) {
+        stream->send_status(lsn_type{builder->lsn()}.value());
+    }
 
-        vout << "Reading replication log...\n";
-        pqxx::result const result = txn.exec_prepared(
-            "peek", config.replication_slot(), config.publication());
+    builder->clear_committed();
+}
 
-        if (result.empty()) {
-            vout << "No changes found.\n";
-            vout << "Did not write log file.\n";
-            txn.commit();
-            vout << "Done.\n";
-            return true;
-        }
+bool follow(osmium::VerboseOutput &vout, Config const &config,
+            GetLogOptions const &options)
+{
+    vout << "Connecting to database for streaming replication...\n";
+    replication_stream stream{config.db_connection(),
+                              config.replication_slot(),
+                              config.publication(),
+                              get_plugin_options(options)};
+    check_server_version(stream.server_version(), options);
+    stream.start();
+
+    if (!options.catchup()) {
+        vout << "Not confirming changes (use --catchup if you want this).\n";
+    }
 
-        vout << "There are " << result.size()
-             << " entries in the replication log.\n";
+    // NOLINTNEXTLINE(cert-err33-c)
+    std::signal(SIGINT, handle_stop_signal);
+    // NOLINTNEXTLINE(cert-err33-c)
+    std::signal(SIGTERM, handle_stop_signal);
 
-        std::string data;
-        data.reserve(result.size() * 50UL); // log lines should fit in 50 bytes
+    vout << "Streaming changes (stop with SIGINT or SIGTERM)...\n";
 
-        bool data_in_current_transaction = false;
-        bool has_actual_data = false;
+    pgoutput::log_builder builder{options.buffer_size(),
+                                  builder_format(options)};
+    xlog_data msg;
+    auto last_flush = std::chrono::steady_clock::now();
 
-        pgoutput::parser parser;
+    while (!stop_requested) {
+        if (stream.read(&msg, stream_idle_timeout)) {
+            builder.add_message(lsn_type{msg.lsn}, msg.data);
+            if (builder.committed_data().size() < options.buffer_size() &&
+                std::chrono::steady_clock::now() - last_flush <
+                    stream_flush_interval) {
+                continue;
+            }
+        }
 
-        for (auto const &row : result) {
-            std::string message;
+        flush_stream_log(vout, config, options, &builder, &stream);
+        last_flush = std::chrono::steady_clock::now();
+    }
 
-            auto hex = hex2bytes(psql_field_to_string_view(row[2]));
-            std::string_view binary_string(hex.data(), hex.size());
+    vout << "Stopping...\n";
+    flush_stream_log(vout, config, options, &builder, &stream);
+    stream.stop();
 
-            parser.set_row(binary_string);
-            const auto op = parser.parse_op(); // read pgoutput operation
+    vout << "Done.\n";
 
-            switch (op) {
+    return true;
+}
 
-            case 'B': // begin transaction
-                data_in_current_transaction = false;
-                continue;
+// Query for up to max_changes changes from the replication slot (0 means
+// no limit).
+std::string peek_query(GetLogOptions const &options, uint32_t max_changes)
+{
+    // The result is fetched in binary format, so the text cast on the
+    // lsn gets us the usual representation and the data is not hex encoded.
+    std::string select{"SELECT lsn::text, data FROM "
+                       "pg_logical_slot_peek_binary_changes($1, NULL, "};
+    if (max_changes > 0) {
+        select += std::to_string(max_changes);
+    } else {
+        select += "NULL";
+    }
+    for (auto const &[name, value] : get_plugin_options(options)) {
+        select += ", '" + name + "', '" + value + "'";
+    }
+    select += ", 'publication_names', $2);";
 
-            case 'C': // commit
-                message = "C";
-                break;
+    return select;
+}
 
-            case 'R': // relation (pg table metadata)
-            {
-                parser.parse_op_relation();
-                continue;
+struct batch_result
+{
+    decode_result decoded;
+    std::size_t log_bytes = 0; // size of the log data before compression
+};
+
+// Read one batch of changes from the replication slot and write them into
+// a log file if there are any.
+batch_result read_batch(osmium::VerboseOutput &vout, Config const &config,
+                        GetLogOptions const &options, pq::connection *peek_db,
+                        std::string const &select)
+{
+    vout << "Reading replication log...\n";
+
+    // Log data is written to this file whenever the buffer is full, so
+    // memory use doesn't depend on the number of changes.
+    IncrementalFile log_file{config.log_dir(),
+                             create_replication_log_name("pending") + ".new"};
+
+    peek_db->send_query_params(
+        select, {config.replication_slot(), config.publication()}, true);
+
+    batch_result result;
+
+    // With binary logs the header is written with the first records, the
+    // trailer on commit.
+    blog::checksum checksum;
+    compressor comp{options.compression()};
+    auto const write = [&](std::string_view data) {
+        result.log_bytes += data.size();
+        if (!options.binary_log()) {
+            // Uncompressed data is written as it is without copying it
+            if (comp.type() == compression_type::none) {
+                log_file.write(data);
+            } else {
+                log_file.write(comp.compress(data));
             }
+            return;
+        }
+        if (data.empty()) {
+            return;
+        }
+        if (log_file.size() == 0) {
+            log_file.write(blog::file_header());
+        }
+        checksum.update(data);
+        log_file.write(data);
+    };
+
+    result.decoded =
+        decode_log([&] { return peek_db->get_result(); }, write,
+                   options.buffer_size(), !options.single_threaded(),
+                   options.decode_threads(), builder_format(options));
+
+    auto const &decoded = result.decoded;
+    if (decoded.entries == 0) {
+        vout << "No changes found.\n";
+        vout << "Did not write log file.\n";
+        return result;
+    }
+
+    vout << "There are " << decoded.entries
+         << " entries in the replication log.\n";
+
+    // With --streaming the changes can be all chunks of transactions which
+    // are still in progress, then there is nothing to write or catch up to
+    if (decoded.lsn.empty()) {
+        vout << "No committed transactions found.\n";
+        vout << "Did not write log file.\n";
+        return result;
+    }
+
+    vout << "LSN is " << decoded.lsn << '\n';
+
+    if (decoded.has_actual_data) {
+        std::string const file_name = log_file_name(decoded.lsn, options);
+        vout << "Writing log to '" << config.log_dir() << file_name
+             << "'...\n";
+        if (options.binary_log()) {
+            log_file.write(checksum.file_trailer());
+        } else {
+            log_file.write(comp.finish());
+        }
+        log_file.commit(file_name);
+        vout << "Wrote and synced log.\n";
+    } else {
+        vout << "No actual changes found.\n";
+        vout << "Did not write log file.\n";
+    }
 
-            case 'I': // insert
-            {
-                message += parser.parse_op_insert();
-                data_in_current_transaction = true;
+    return result;
+}
+
+void catchup(osmium::VerboseOutput &vout, Config const &config,
+             pqxx::connection *db, std::string const &lsn)
+{
+    vout << "Catching up to " << lsn << "...\n";
+    pqxx::work txn{*db};
+    catchup_to_lsn(txn, config.replication_slot(), lsn_type{lsn}.str());
+    txn.commit();
+}
+
+// Read batches of changes until all changes are read, the time budget is
+// used up, or --max-changes changes are read. The size of the batches is
+// adjusted to the measured speed.
+void read_batches(osmium::VerboseOutput &vout, Config const &config,
+                  GetLogOptions const &options, pqxx::connection *db,
+                  pq::connection *peek_db)
+{
+    using clock = std::chrono::steady_clock;
+    auto const deadline = clock::now() + options.time_budget();
+
+    // A batch is not made larger than what fits into the buffer, so it
+    // is usually written in one go.
+    batch_sizer sizer{options.batch_time(), options.buffer_size(),
+                      options.batch_changes()};
+
+    // Batch size needed to get past streamed transactions in progress
+    uint32_t min_changes = 0;
+
+    // Number of changes read in all batches
+    uint64_t total = 0;
+
+    for (unsigned int batch = 1;; ++batch) {
+        auto const start = clock::now();
+        auto changes = std::max(sizer.next(deadline - start), min_changes);
+        bool const limited =
+            options.max_changes() > 0 &&
+            changes >= options.max_changes() - total;
+        if (limited) {
+            changes = static_cast<uint32_t>(options.max_changes() - total);
+        }
+        vout << "Batch " << batch << ": Reading up to " << changes
+             << " changes...\n";
+
+        auto const result =
+            read_batch(vout, config, options, peek_db,
+                       peek_query(options, changes));
+        auto const &decoded = result.decoded;
+        if (decoded.entries == 0) {
+            break;
+        }
+
+        // Only chunks of streamed transactions which are still in progress.
+        // The slot can't be advanced, so the next batch has to be larger to
+        // get to a commit.
+        if (decoded.lsn.empty()) {
+            if (decoded.entries < changes) {
+                vout << "Caught up with the replication log.\n";
                 break;
             }
-
-            case 'U': // update
-            {
-                message += parser.parse_op_update();
-                data_in_current_transaction = true;
+            if (limited) {
+                vout << "Can not read more than --max-changes changes.\n";
                 break;
             }
-
-            default: // skip other operations
-                continue;
+            if (clock::now() >= deadline) {
+                vout << "Time budget used up.\n";
+                break;
             }
+            min_changes = static_cast<uint32_t>(std::min<uint64_t>(
+                static_cast<uint64_t>(changes) * batch_sizer::max_growth,
+                std::numeric_limits<int32_t>::max()));
+            vout << "Batch " << batch
+                 << " has no committed transactions, reading more.\n";
+            continue;
+        }
+        min_changes = 0;
+
+        catchup(vout, config, db, decoded.lsn);
+        total += decoded.entries;
+
+        auto const end = clock::now();
+        sizer.update(decoded.entries, result.log_bytes, end - start);
+        vout << "Batch " << batch << " took "
+             << std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                       start)
+                    .count()
+             << " ms (" << static_cast<uint64_t>(sizer.rate())
+             << " changes/s).\n";
+
+        if (decoded.entries < changes) {
+            vout << "Caught up with the replication log.\n";
+            break;
+        }
+        if (options.max_changes() > 0 && total >= options.max_changes()) {
+            vout << "Read " << total << " changes (--max-changes).\n";
+            break;
+        }
+        if (end >= deadline) {
+            vout << "Time budget used up.\n";
+            break;
+        }
+    }
+}
 
-            if (data_in_current_transaction) {
-                data.append(row[0].c_str());
-                data += ' ';
-                data.append(row[1].c_str());
-                data += ' ';
-                data.append(message);
-                data += '\n';
-            }
+} // anonymous namespace
 
-            if (message[0] == 'C') {
-                lsn = row[0].c_str();
-                data_in_current_transaction = false;
-            } else if (message[0] == 'N') {
-                has_actual_data = true;
-            }
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         GetLogOptions const &options)
+{
+    // All commands writing log files and/or advancing the replication slot
+    // use the same pid/lock file.
+    PIDFile const pid_file{config.run_dir(), "osmdbt-log"};
+
+    if (options.follow()) {
+        return follow(vout, config, options);
+    }
+
+    vout << "Connecting to database...\n";
+    pqxx::connection db{config.db_connection()};
+    pq::connection peek_db{config.db_connection()};
+
+    if (options.time_budget().count() > 0) {
+        vout << "Reading batches of changes for up to "
+             << options.time_budget().count()
+             << " seconds (change with --time-budget)\n";
+        if (options.max_changes() > 0) {
+            vout << "Reading up to " << options.max_changes()
+                 << " changes in all batches (change with --max-changes)\n";
         }
+    } else if (options.max_changes() > 0) {
+        vout << "Reading up to " << options.max_changes()
+             << " changes (change with --max-changes)\n";
+    } else {
+        vout << "Reading any number of changes (change with --max-changes)\n";
+    }
 
-        vout << "LSN is " << lsn << '\n';
+    {
+        pqxx::read_transaction txn{db};
+        vout << "Database version: " << get_db_version(txn) << '\n';
+        txn.commit();
+    }
 
-        if (has_actual_data) {
-            std::string lsn_dash{"lsn-"};
-            std::transform(lsn.cbegin(), lsn.cend(),
-                           std::back_inserter(lsn_dash),
-                           [](char c) { return c == '/' ? '-' : c; });
+    check_server_version(db.server_version(), options);
 
-            std::string const file_name = create_replication_log_name(lsn_dash);
-            vout << "Writing log to '" << config.log_dir() << file_name
-                 << "'...\n";
+    if (options.time_budget().count() > 0) {
+        read_batches(vout, config, options, &db, &peek_db);
+        vout << "Done.\n";
+        return true;
+    }
 
-            write_data_to_file(data, config.log_dir(), file_name);
-            vout << "Wrote and synced log.\n";
-        } else {
-            vout << "No actual changes found.\n";
-            vout << "Did not write log file.\n";
-        }
+    auto const result =
+        read_batch(vout, config, options, &peek_db,
+                   peek_query(options, options.max_changes()));
+    // Nothing committed, so nothing to catch up to
+    if (result.decoded.lsn.empty()) {
+        vout << "Done.\n";
+        return true;
     }
 
     if (options.catchup()) {
-        vout << "Catching up to " << lsn << "...\n";
-        pqxx::work txn{db};
-        catchup_to_lsn(txn, config.replication_slot(), lsn_type{lsn}.str());
-        txn.commit();
+        catchup(vout, config, &db, result.decoded.lsn);
     } else {
         vout << "Not catching up (use --catchup if you want this).\n";
     }
@@ -245,7 +674,6 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
     return true;
 }
 
-
 int main(int argc, char *argv[])
 {
     GetLogOptions options;
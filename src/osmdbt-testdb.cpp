@@ -5,6 +5,7 @@
 #include "options.hpp"
 #include "util.hpp"
 
+#include <cstddef>
 #include <iostream>
 
 namespace {
@@ -64,14 +65,15 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
             }
             if (has_configured_replication_slot) {
                 db.prepare("peek",
-                           "SELECT lsn, xid, encode(data, 'hex') as data FROM pg_logical_slot_peek_binary_changes($1, "
+                           "SELECT count(*) FROM pg_logical_slot_peek_binary_changes($1, "
                            "NULL, NULL, 'proto_version', '1', 'publication_names', $2);");
                 pqxx::result const result_peek =
                     txn.exec_prepared("peek", config.replication_slot(), config.publication());
-                if (result_peek.empty()) {
+                auto const changes = result_peek[0][0].as<std::size_t>();
+                if (changes == 0) {
                     vout << "There are no";
                 } else {
-                    vout << "There are " << result_peek.size();
+                    vout << "There are " << changes;
                 }
                 vout << " changes in your configured replication slot.\n";
             } else {
@@ -1,17 +1,16 @@
 
 #include "osmobj.hpp"
+#include "binlog.hpp"
+#include "compression.hpp"
 
 #include <osmium/util/string.hpp>
 
 #include <algorithm>
 #include <cassert>
-#include <cerrno>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <string>
-#include <system_error>
 #include <vector>
 
 osmobj::osmobj(std::string const &obj, std::string const &version,
@@ -41,21 +40,64 @@ osmobj::osmobj(std::string const &obj, std::string const &version,
     m_cid = std::strtoll(&changeset[1], nullptr, 10);
 
     if (cucache) {
-        (*cucache)[m_cid] = {};
+        cucache->add(m_cid);
     }
 }
 
+osmobj::osmobj(osmium::item_type type, osmium::object_id_type id,
+               osmium::object_version_type version,
+               osmium::changeset_id_type changeset,
+               changeset_user_lookup *cucache)
+: m_type(type), m_id(id), m_version(version), m_cid(changeset)
+{
+    if (cucache) {
+        cucache->add(m_cid);
+    }
+}
+
+namespace {
+
+void read_binary_log(osmobjects &objects_todo, std::string const &path,
+                     changeset_user_lookup *cucache)
+{
+    blog::mapped_file const logfile{path};
+
+    for (std::size_t n = 0; n < logfile.size(); ++n) {
+        auto const rec = logfile.get(n);
+        if (rec.op == 'X') {
+            std::string line;
+            blog::append_text(&line, rec);
+            line.pop_back();
+            std::cerr << "Error found in logfile: " << line << '\n';
+            continue;
+        }
+        if (rec.op != 'N') {
+            continue;
+        }
+
+        auto const type = osmium::char_to_item_type(rec.type);
+        if (type != osmium::item_type::node && type != osmium::item_type::way &&
+            type != osmium::item_type::relation) {
+            throw std::runtime_error{
+                "Log file has wrong format: type must be 'n', 'w', or 'r'"};
+        }
+        objects_todo.add(type, rec.id, rec.version, rec.changeset, cucache);
+    }
+}
+
+} // anonymous namespace
+
 void read_log(osmobjects &objects_todo, std::string const &dir_name,
               std::string const &file_name, changeset_user_lookup *cucache)
 {
-    std::ifstream logfile{dir_name + file_name};
-    if (!logfile.is_open()) {
-        throw std::system_error{errno, std::system_category(),
-                                "Could not open log file '" + dir_name +
-                                    file_name + "'"};
+    if (blog::is_binary_log_name(file_name)) {
+        read_binary_log(objects_todo, dir_name + file_name, cucache);
+        return;
     }
 
-    for (std::string line; std::getline(logfile, line);) {
+    line_reader logfile{dir_name + file_name};
+
+    for (std::string line; logfile.getline(&line);) {
         auto const parts = osmium::split_string(line, ' ');
         if (parts.size() < 3) {
             std::cerr << "Warning: Ignored log line due to wrong formatting: "
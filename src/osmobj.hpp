@@ -1,5 +1,7 @@
 #pragma once
 
+#include "cslookup.hpp"
+
 #include <osmium/builder/osm_object_builder.hpp>
 #include <osmium/index/nwr_array.hpp>
 #include <osmium/osm/types.hpp>
@@ -11,15 +13,6 @@
 #include <unordered_map>
 #include <vector>
 
-struct userinfo
-{
-    osmium::user_id_type id = 0;
-    std::string username;
-};
-
-using changeset_user_lookup =
-    std::unordered_map<osmium::changeset_id_type, userinfo>;
-
 class osmobj
 {
 public:
@@ -27,6 +20,11 @@ public:
                     std::string const &changeset,
                     changeset_user_lookup *cucache = nullptr);
 
+    osmobj(osmium::item_type type, osmium::object_id_type id,
+           osmium::object_version_type version,
+           osmium::changeset_id_type changeset,
+           changeset_user_lookup *cucache = nullptr);
+
     [[nodiscard]] osmium::item_type type() const noexcept { return m_type; }
 
     [[nodiscard]] osmium::object_id_type id() const noexcept { return m_id; }
@@ -117,6 +115,14 @@ public:
         m_objects(obj.type()).push_back(obj);
     }
 
+    void add(osmium::item_type type, osmium::object_id_type id,
+             osmium::object_version_type version,
+             osmium::changeset_id_type changeset,
+             changeset_user_lookup *cucache)
+    {
+        m_objects(type).emplace_back(type, id, version, changeset, cucache);
+    }
+
     void sort();
 
 private:
@@ -124,6 +130,11 @@ private:
 
 }; // class osmobjects
 
+/**
+ * Read objects from log file. Binary logs are recognized by their name
+ * (see blog::is_binary_log_name()), all others are read as text logs,
+ * which are decompressed if they have the suffix ".gz" or ".zst".
+ */
 void read_log(osmobjects &objects_todo, std::string const &dir_name,
               std::string const &file_name,
               changeset_user_lookup *cucache = nullptr);
@@ -0,0 +1,90 @@
+#include "pgarray.hpp"
+#include "pq.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+pg_binary_array::pg_binary_array(std::string_view data,
+                                 std::uint32_t element_type)
+: m_data(data)
+{
+    auto const dimensions = read_int32();
+    auto const has_null = read_int32();
+    auto const type = static_cast<std::uint32_t>(read_int32());
+
+    if (dimensions < 0 || dimensions > 1) {
+        error("only one-dimensional arrays are supported");
+    }
+    if (has_null != 0) {
+        error("NULL elements are not supported");
+    }
+    if (type != element_type) {
+        error("unexpected element type");
+    }
+
+    // Empty arrays have no dimensions
+    if (dimensions == 1) {
+        auto const size = read_int32();
+        read_int32(); // lower bound
+        if (size < 0) {
+            error("negative size");
+        }
+        m_size = static_cast<std::size_t>(size);
+    }
+}
+
+void pg_binary_array::error(char const *message)
+{
+    throw std::runtime_error{std::string{"Malformed array in binary format: "} +
+                             message};
+}
+
+std::int32_t pg_binary_array::read_int32()
+{
+    std::int32_t value = 0;
+    if (m_data.size() - m_pos < sizeof(value) ||
+        !pq::from_binary(m_data.substr(m_pos, sizeof(value)), &value)) {
+        error("truncated data");
+    }
+    m_pos += sizeof(value);
+    return value;
+}
+
+bool pg_binary_array::next(std::string_view *element)
+{
+    if (m_read == m_size) {
+        if (m_pos != m_data.size()) {
+            error("more data after last element");
+        }
+        return false;
+    }
+
+    auto const length = read_int32();
+    if (length < 0) {
+        error("NULL elements are not supported");
+    }
+    if (m_data.size() - m_pos < static_cast<std::size_t>(length)) {
+        error("truncated data");
+    }
+
+    *element = m_data.substr(m_pos, static_cast<std::size_t>(length));
+    m_pos += static_cast<std::size_t>(length);
+    ++m_read;
+
+    return true;
+}
+
+bool pg_binary_array::next(std::int64_t *value)
+{
+    std::string_view element;
+    if (!next(&element)) {
+        return false;
+    }
+
+    if (!pq::from_binary(element, value)) {
+        error("unexpected size of integer");
+    }
+
+    return true;
+}
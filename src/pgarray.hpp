@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Reader for one-dimensional PostgreSQL arrays in binary format, for
+ * instance the result of array_agg() in a query with binary results.
+ *
+ * The data starts with a header: the number of dimensions, a flag that
+ * is set if there are NULL elements, and the type OID of the elements.
+ * It is followed by the size and lower bound of each dimension and then
+ * by the elements, each with its length in bytes in front. All integers
+ * are in network byte order. Elements are returned one after the other
+ * as views into the data, nothing is copied.
+ *
+ * NULL elements are not supported, arrays handled by osmdbt never have
+ * them.
+ */
+class pg_binary_array
+{
+public:
+    // Type OIDs of the element types used by osmdbt
+    static constexpr std::uint32_t const int8_oid = 20;
+    static constexpr std::uint32_t const text_oid = 25;
+
+    /**
+     * Read the header of the array.
+     *
+     * @param data The array in binary format.
+     * @param element_type The type OID the elements must have.
+     * @throws std::runtime_error if the array is malformed or has
+     *         elements of another type.
+     */
+    pg_binary_array(std::string_view data, std::uint32_t element_type);
+
+    /// The number of elements.
+    [[nodiscard]] std::size_t size() const noexcept { return m_size; }
+
+    /**
+     * Get the next element.
+     *
+     * @returns false if there are no more elements.
+     * @throws std::runtime_error if the array is malformed.
+     */
+    bool next(std::string_view *element);
+
+    /**
+     * Get the next element of an int8 array.
+     *
+     * @returns false if there are no more elements.
+     * @throws std::runtime_error if the array is malformed.
+     */
+    bool next(std::int64_t *value);
+
+private:
+    [[noreturn]] static void error(char const *message);
+
+    std::int32_t read_int32();
+
+    std::string_view m_data;
+    std::size_t m_pos = 0;
+    std::size_t m_size = 0;
+    std::size_t m_read = 0;
+
+}; // class pg_binary_array
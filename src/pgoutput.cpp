@@ -1,5 +1,14 @@
 #include "pgoutput.hpp"
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+
 // Reference documentation for pgoutput decoding:
 // https://www.postgresql.org/docs/current/protocol-logicalrep-message-formats.html
 
@@ -8,57 +17,92 @@ namespace pgoutput {
 template <typename T>
 T row_low_level_parser::read()
 {
+    if (sizeof(T) > m_row.size() - m_offset) {
+        throw std::runtime_error("Truncated pgoutput data");
+    }
     auto result = read_network_byte_order<T>(m_row.data() + m_offset);
     m_offset += sizeof(T);
     return result;
 }
 
-std::string row_low_level_parser::read_string()
+std::string_view row_low_level_parser::read_string()
 {
-    std::string result{m_row.data() + m_offset};
+    auto const end = m_row.find('\0', m_offset);
+    if (end == std::string_view::npos) {
+        throw std::runtime_error("Missing string terminator in pgoutput data");
+    }
+    auto const result = m_row.substr(m_offset, end - m_offset);
     m_offset += result.size() + 1;
     return result;
 }
 
-std::string row_low_level_parser::read_string(uint32_t len)
+std::string_view row_low_level_parser::read_string(uint32_t len)
 {
-    std::string result{m_row.data() + m_offset, len};
+    if (len > m_row.size() - m_offset) {
+        throw std::runtime_error("Truncated pgoutput data");
+    }
+    auto const result = m_row.substr(m_offset, len);
     m_offset += len;
     return result;
 }
 
-std::vector<std::optional<std::string>> row_low_level_parser::read_tuple_data()
+tuple_view
+row_low_level_parser::read_tuple_data(relevant_table_columns const &columns)
 {
-    std::vector<std::optional<std::string>> result;
+    tuple_view result;
     auto n_columns = read<int16_t>();
 
     for (int i = 0; i < n_columns; i++) {
+        std::optional<column_value> value;
+
         auto col_data_category = read<int8_t>();
         switch (col_data_category) {
         case 'n': // null value column
-        case 'u':
-            result.emplace_back();
+        case 'u': // unchanged toasted value
             break;
         case 't': {
             // text column
             auto col_length = read<int32_t>();
-            result.emplace_back(read_string(col_length));
+            value = column_value{read_string(col_length), false};
             break;
         }
-        case 'b':
-            // ignore binary column for now
-            result.emplace_back();
+        case 'b': {
+            // binary column
+            auto col_length = read<int32_t>();
+            value = column_value{read_string(col_length), true};
             break;
+        }
         default:
-            // ignore unknown column category
-            result.emplace_back();
-            break;
+            throw std::runtime_error("Unknown column category in tuple data");
+        }
+
+        if (i == columns.osm_object_column) {
+            result.osm_object = value;
+        } else if (i == columns.changeset_column) {
+            result.changeset = value;
+        } else if (i == columns.version_column) {
+            result.version = value;
+        } else if (i == columns.redaction_column) {
+            result.redaction = value;
         }
     }
 
     return result;
 }
 
+void row_low_level_parser::skip_tuple_data()
+{
+    auto n_columns = read<int16_t>();
+
+    for (int i = 0; i < n_columns; i++) {
+        auto col_data_category = read<int8_t>();
+        if (col_data_category == 't' || col_data_category == 'b') {
+            auto col_length = read<int32_t>();
+            read_string(col_length);
+        }
+    }
+}
+
 // pgoutput data is provided in network byte order (big endian)
 template <typename T>
 T row_low_level_parser::read_network_byte_order(const char *input)
@@ -68,8 +112,9 @@ T row_low_level_parser::read_network_byte_order(const char *input)
     // TODO: could use bswap intrinsic instead
     T_unsigned result{};
     for (unsigned int i = 0; i < sizeof(T); i++) {
-        result += static_cast<unsigned char>(input[i])
-                  << (8ULL * (sizeof(T) - i - 1));
+        result += static_cast<T_unsigned>(
+            static_cast<T_unsigned>(static_cast<unsigned char>(input[i]))
+            << (8ULL * (sizeof(T) - i - 1)));
     }
     return static_cast<T>(result);
 }
@@ -81,17 +126,51 @@ void parser::set_row(std::string_view row)
 
 unsigned char parser::parse_op() { return m_msg.read<uint8_t>(); }
 
+uint32_t parser::parse_op_begin()
+{
+    /* auto final_lsn = */ m_msg.read<int64_t>();
+    /* auto commit_timestamp = */ m_msg.read<int64_t>();
+    return m_msg.read<uint32_t>();
+}
+
+uint32_t parser::parse_xid() { return m_msg.read<uint32_t>(); }
+
+uint32_t parser::parse_op_stream_start()
+{
+    auto xid = m_msg.read<uint32_t>();
+    /* auto first_segment = */ m_msg.read<int8_t>();
+    return xid;
+}
+
+uint32_t parser::parse_op_stream_commit()
+{
+    auto xid = m_msg.read<uint32_t>();
+    /* auto flags = */ m_msg.read<int8_t>();
+    /* auto commit_lsn = */ m_msg.read<int64_t>();
+    /* auto end_lsn = */ m_msg.read<int64_t>();
+    /* auto commit_timestamp = */ m_msg.read<int64_t>();
+    return xid;
+}
+
+std::pair<uint32_t, uint32_t> parser::parse_op_stream_abort()
+{
+    auto xid = m_msg.read<uint32_t>();
+    auto subxid = m_msg.read<uint32_t>();
+    return {xid, subxid};
+}
+
 void parser::parse_op_relation()
 {
     relevant_table_columns cols;
-    std::string object_id_field;
+    std::string_view object_id_field;
 
     auto relation_id = m_msg.read<int32_t>();
-    auto ns = m_msg.read_string();
+    /* auto ns = */ m_msg.read_string();
     auto relation_name = m_msg.read_string();
     /* auto replica_identity = */ m_msg.read<int8_t>();
     auto number_of_columns = m_msg.read<uint16_t>();
 
+    cols.relation_id = relation_id;
     cols.relation_name = relation_name;
 
     if (relation_name == "nodes") {
@@ -108,8 +187,8 @@ void parser::parse_op_relation()
     } else {
         throw std::runtime_error(
             "pgoutput provided unexpected relation metadata for " +
-            relation_name + " (relation_id: " + std::to_string(relation_id) +
-            ")");
+            std::string{relation_name} +
+            " (relation_id: " + std::to_string(relation_id) + ")");
     }
 
     int found_columns = 0;
@@ -136,44 +215,218 @@ void parser::parse_op_relation()
     }
 
     if (found_columns != 4) {
-        throw std::runtime_error("Missing column in relation " + relation_name);
+        throw std::runtime_error("Missing column in relation " +
+                                 std::string{relation_name});
     }
 
-    m_relevant_columns_per_rel_id[relation_id] = cols;
+    // Relation metadata is sent again if the table changes
+    for (auto &rel : m_relevant_columns_per_rel_id) {
+        if (rel.relation_id == relation_id) {
+            rel = std::move(cols);
+            return;
+        }
+    }
+    m_relevant_columns_per_rel_id.push_back(std::move(cols));
 }
 
-std::string parser::parse_op_insert()
+relevant_table_columns const &parser::columns_for(int32_t relation_id)
+{
+    auto const &rels = m_relevant_columns_per_rel_id;
+
+    // Changes usually come in runs for the same relation
+    if (m_last_relation < rels.size() &&
+        rels[m_last_relation].relation_id == relation_id) {
+        return rels[m_last_relation];
+    }
+
+    for (std::size_t i = 0; i < rels.size(); ++i) {
+        if (rels[i].relation_id == relation_id) {
+            m_last_relation = i;
+            return rels[i];
+        }
+    }
+
+    throw std::runtime_error("Missing metadata for relation id " +
+                             std::to_string(relation_id));
+}
+
+namespace {
+
+// Binary values of the integer columns we are interested in are the
+// integers in network byte order.
+template <typename T>
+T integer_from_network(std::string_view data) noexcept
+{
+    using T_unsigned = typename std::make_unsigned<T>::type;
+
+    T_unsigned value{};
+    for (char const c : data) {
+        value = static_cast<T_unsigned>(value << 8U) |
+                static_cast<unsigned char>(c);
+    }
+
+    return static_cast<T>(value);
+}
+
+template <typename T>
+void append_integer(std::string *result, std::string_view data)
+{
+    std::array<char, 24> buffer{};
+    auto const r = std::to_chars(buffer.data(), buffer.data() + buffer.size(),
+                                 integer_from_network<T>(data));
+    result->append(buffer.data(), r.ptr);
+}
+
+void check_column(std::optional<column_value> const &value, char const *name)
+{
+    if (!value) {
+        throw std::runtime_error(std::string{"Missing value for "} + name +
+                                 " column");
+    }
+}
+
+void append_column(std::string *result, std::optional<column_value> value,
+                   char const *name)
+{
+    check_column(value, name);
+
+    if (!value->binary) {
+        result->append(value->data);
+        return;
+    }
+
+    switch (value->data.size()) {
+    case 8: // bigint
+        append_integer<int64_t>(result, value->data);
+        break;
+    case 4: // integer
+        append_integer<int32_t>(result, value->data);
+        break;
+    case 2: // smallint
+        append_integer<int16_t>(result, value->data);
+        break;
+    default:
+        throw std::runtime_error(std::string{"Unexpected binary value for "} +
+                                 name + " column");
+    }
+}
+
+void append_object(std::string *result, relevant_table_columns const &columns,
+                   tuple_view const &tuple)
+{
+    *result += columns.object_type;
+    append_column(result, tuple.osm_object, "object id");
+    *result += " v";
+    append_column(result, tuple.version, "version");
+    *result += " c";
+    append_column(result, tuple.changeset, "changeset");
+}
+
+// The value of an integer column in text or binary format
+template <typename T>
+T column_number(std::optional<column_value> const &value, char const *name)
+{
+    check_column(value, name);
+
+    std::int64_t number = 0;
+    auto const &data = value->data;
+    if (!value->binary) {
+        auto const r =
+            std::from_chars(data.data(), data.data() + data.size(), number);
+        if (r.ec != std::errc{} || r.ptr != data.data() + data.size()) {
+            throw std::runtime_error(std::string{"Invalid value for "} + name +
+                                     " column");
+        }
+    } else {
+        switch (data.size()) {
+        case 8: // bigint
+            number = integer_from_network<int64_t>(data);
+            break;
+        case 4: // integer
+            number = integer_from_network<int32_t>(data);
+            break;
+        case 2: // smallint
+            number = integer_from_network<int16_t>(data);
+            break;
+        default:
+            throw std::runtime_error(
+                std::string{"Unexpected binary value for "} + name +
+                " column");
+        }
+    }
+
+    return static_cast<T>(number);
+}
+
+void fill_object(blog::record *rec, relevant_table_columns const &columns,
+                 tuple_view const &tuple)
+{
+    rec->type = columns.object_type;
+    rec->id = column_number<int64_t>(tuple.osm_object, "object id");
+    rec->version = column_number<uint32_t>(tuple.version, "version");
+    rec->changeset = column_number<int64_t>(tuple.changeset, "changeset");
+}
+
+} // anonymous namespace
+
+void parser::parse_op_insert(std::string *result)
 {
-    std::string result;
     auto relation_id = m_msg.read<int32_t>();
     /* auto new_tuple_byte = */ m_msg.read<uint8_t>();
-    auto new_tuple = m_msg.read_tuple_data();
-
-    if (m_relevant_columns_per_rel_id.find(relation_id) ==
-        m_relevant_columns_per_rel_id.end()) {
-        throw std::runtime_error("Missing metadata for relation id " +
-                                 std::to_string(relation_id));
-    }
-
-    auto columns = m_relevant_columns_per_rel_id[relation_id];
-    result += "N ";
-    result += columns.object_type;
-    result += *new_tuple[columns.osm_object_column];
-    result += " v";
-    result += *new_tuple[columns.version_column];
-    result += " c";
-    result += *new_tuple[columns.changeset_column];
-    return result;
+
+    auto const &columns = columns_for(relation_id);
+    auto const new_tuple = m_msg.read_tuple_data(columns);
+
+    *result += "N ";
+    append_object(result, columns, new_tuple);
 }
 
-std::string parser::parse_op_update()
+void parser::parse_op_update(std::string *result)
+{
+    auto relation_id = m_msg.read<int32_t>();
+    auto tuple_byte = m_msg.read<uint8_t>();
+    // skip key field and old tuple, we only care about the new tuple
+    if (tuple_byte == 'K' || tuple_byte == 'O') {
+        m_msg.skip_tuple_data();
+        tuple_byte = m_msg.read<uint8_t>();
+    }
+
+    if (tuple_byte != 'N') {
+        throw std::runtime_error("Update: expected N tuple byte");
+    }
+
+    auto const &columns = columns_for(relation_id);
+    auto const new_tuple = m_msg.read_tuple_data(columns);
+
+    *result += "R ";
+    append_object(result, columns, new_tuple);
+    *result += ' ';
+    if (new_tuple.redaction) {
+        append_column(result, new_tuple.redaction, "redaction");
+    } else {
+        *result += "NULL";
+    }
+}
+
+void parser::parse_op_insert(blog::record *rec)
+{
+    auto relation_id = m_msg.read<int32_t>();
+    /* auto new_tuple_byte = */ m_msg.read<uint8_t>();
+
+    auto const &columns = columns_for(relation_id);
+    auto const new_tuple = m_msg.read_tuple_data(columns);
+
+    rec->op = 'N';
+    fill_object(rec, columns, new_tuple);
+}
+
+void parser::parse_op_update(blog::record *rec)
 {
-    std::string result;
     auto relation_id = m_msg.read<int32_t>();
     auto tuple_byte = m_msg.read<uint8_t>();
     // skip key field and old tuple, we only care about the new tuple
     if (tuple_byte == 'K' || tuple_byte == 'O') {
-        m_msg.read_tuple_data();
+        m_msg.skip_tuple_data();
         tuple_byte = m_msg.read<uint8_t>();
     }
 
@@ -181,25 +434,333 @@ std::string parser::parse_op_update()
         throw std::runtime_error("Update: expected N tuple byte");
     }
 
-    auto new_tuple = m_msg.read_tuple_data();
+    auto const &columns = columns_for(relation_id);
+    auto const new_tuple = m_msg.read_tuple_data(columns);
+
+    rec->op = 'R';
+    fill_object(rec, columns, new_tuple);
+    rec->redaction = new_tuple.redaction
+                         ? column_number<int32_t>(new_tuple.redaction,
+                                                  "redaction")
+                         : blog::no_redaction;
+}
+
+namespace {
+
+// Spilled data of aborted subtransactions is removed in pieces of this size
+constexpr std::size_t const copy_chunk_size = 1024UL * 1024UL;
+
+} // anonymous namespace
+
+void stream_store::add(uint32_t xid, uint32_t subxid, std::string_view line,
+                       bool actual_data)
+{
+    append(&m_transactions[xid], subxid, line, actual_data ? 1 : 0);
+}
+
+void stream_store::append(transaction *txn, uint32_t subxid,
+                          std::string_view data, std::size_t inserts)
+{
+    if (txn->runs.empty() || txn->runs.back().subxid != subxid) {
+        txn->runs.push_back({subxid, txn->spilled + txn->data.size(), 0});
+    }
+    txn->runs.back().inserts += inserts;
+    txn->data.append(data);
+
+    if (txn->data.size() <= m_spill_size) {
+        return;
+    }
+
+    if (!txn->spill_file) {
+        txn->spill_file.reset(std::tmpfile());
+        if (!txn->spill_file) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Could not create spill file"};
+        }
+    }
+
+    std::FILE *file = txn->spill_file.get();
+    if (std::fseek(file, 0, SEEK_END) != 0 ||
+        std::fwrite(txn->data.data(), 1, txn->data.size(), file) !=
+            txn->data.size()) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not write to spill file"};
+    }
+    txn->spilled += txn->data.size();
+    txn->data.clear();
+}
+
+void stream_store::read(transaction const &txn, std::size_t offset,
+                        std::size_t size, std::string *out)
+{
+    if (offset < txn.spilled) {
+        auto const length = std::min(size, txn.spilled - offset);
+        auto const old_size = out->size();
+        out->resize(old_size + length);
+
+        std::FILE *file = txn.spill_file.get();
+        if (std::fseek(file, static_cast<long>(offset), SEEK_SET) != 0 ||
+            std::fread(&(*out)[old_size], 1, length, file) != length) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Could not read from spill file"};
+        }
+
+        offset += length;
+        size -= length;
+    }
 
-    if (m_relevant_columns_per_rel_id.find(relation_id) ==
-        m_relevant_columns_per_rel_id.end()) {
-        throw std::runtime_error("Missing metadata for relation id " +
-                                 std::to_string(relation_id));
+    if (size > 0) {
+        out->append(txn.data, offset - txn.spilled, size);
+    }
+}
+
+bool stream_store::commit(uint32_t xid, std::string *out)
+{
+    auto const it = m_transactions.find(xid);
+    if (it == m_transactions.end()) {
+        return false;
     }
 
-    auto columns = m_relevant_columns_per_rel_id[relation_id];
+    auto const &txn = it->second;
+    read(txn, 0, txn.spilled + txn.data.size(), out);
+
+    bool const actual_data =
+        std::any_of(txn.runs.cbegin(), txn.runs.cend(),
+                    [](run const &r) { return r.inserts > 0; });
+
+    m_transactions.erase(it);
+    return actual_data;
+}
 
-    result += "R ";
-    result += columns.object_type;
-    result += *new_tuple[columns.osm_object_column];
-    result += " v";
-    result += *new_tuple[columns.version_column];
-    result += " c";
-    result += *new_tuple[columns.changeset_column];
-    result += " ";
-    result += new_tuple[columns.redaction_column].value_or("NULL");
+void stream_store::abort(uint32_t xid, uint32_t subxid)
+{
+    auto const it = m_transactions.find(xid);
+    if (it == m_transactions.end()) {
+        return;
+    }
+
+    if (subxid == xid) {
+        m_transactions.erase(it);
+        return;
+    }
+
+    auto &txn = it->second;
+    if (std::none_of(txn.runs.cbegin(), txn.runs.cend(),
+                     [&](run const &r) { return r.subxid == subxid; })) {
+        return;
+    }
+
+    // Copy everything except the lines of the aborted subtransaction
+    transaction kept;
+    std::string buffer;
+    std::size_t const total = txn.spilled + txn.data.size();
+    for (std::size_t i = 0; i < txn.runs.size(); ++i) {
+        auto const &r = txn.runs[i];
+        if (r.subxid == subxid) {
+            continue;
+        }
+
+        auto const end =
+            (i + 1 < txn.runs.size()) ? txn.runs[i + 1].offset : total;
+        auto inserts = r.inserts;
+        for (auto offset = r.offset; offset < end;) {
+            auto const size = std::min(end - offset, copy_chunk_size);
+            buffer.clear();
+            read(txn, offset, size, &buffer);
+            append(&kept, r.subxid, buffer, inserts);
+            inserts = 0;
+            offset += size;
+        }
+    }
+
+    txn = std::move(kept);
+}
+
+void log_builder::set_xid(uint32_t xid)
+{
+    m_xid_value = xid;
+    if (m_format == log_format::text) {
+        m_xid = std::to_string(xid);
+    }
+}
+
+void log_builder::append_change(std::string *out, std::string_view lsn_text,
+                                std::uint64_t lsn, unsigned char op)
+{
+    if (m_format == log_format::records) {
+        blog::record rec{};
+        rec.lsn = lsn;
+        rec.xid = m_xid_value;
+        if (op == 'I') {
+            m_parser.parse_op_insert(&rec);
+        } else {
+            m_parser.parse_op_update(&rec);
+        }
+        blog::append(out, rec);
+        return;
+    }
+
+    out->append(lsn_text);
+    *out += ' ';
+    out->append(m_xid);
+    *out += ' ';
+
+    if (op == 'I') {
+        m_parser.parse_op_insert(out);
+    } else {
+        m_parser.parse_op_update(out);
+    }
+    *out += '\n';
+}
+
+void log_builder::finish_transaction(std::string_view lsn_text,
+                                     std::uint64_t lsn, bool data,
+                                     bool actual_data)
+{
+    if (data && m_format == log_format::records) {
+        blog::record rec{};
+        rec.lsn = lsn;
+        rec.xid = m_xid_value;
+        rec.op = 'C';
+        blog::append(&m_data, rec);
+    } else if (data) {
+        m_data.append(lsn_text);
+        m_data += ' ';
+        m_data.append(m_xid);
+        m_data += " C\n";
+    }
+    if (lsn_text.empty()) {
+        lsn_text = lsn_type{lsn}.format(m_lsn_buffer.data());
+    }
+    m_lsn = lsn_text;
+    m_committed_size = m_data.size();
+    m_has_actual_data = m_has_actual_data || actual_data;
+    m_has_commits = true;
+}
+
+namespace {
+
+// Only changes and commits are written with their LSN
+bool writes_lsn(std::string_view message) noexcept
+{
+    return !message.empty() &&
+           std::string_view{"IUCc"}.find(message[0]) != std::string_view::npos;
+}
+
+} // anonymous namespace
+
+void log_builder::add(std::string_view lsn_text, std::uint64_t lsn,
+                      std::string_view message)
+{
+    m_parser.set_row(message);
+    auto const op = m_parser.parse_op(); // read pgoutput operation
+
+    switch (op) {
+
+    case 'B': // begin transaction
+        set_xid(m_parser.parse_op_begin());
+        m_data_in_current_transaction = false;
+        m_actual_data_in_current_transaction = false;
+        break;
+
+    case 'C': // commit
+        finish_transaction(lsn_text, lsn, m_data_in_current_transaction,
+                           m_actual_data_in_current_transaction);
+        m_data_in_current_transaction = false;
+        m_actual_data_in_current_transaction = false;
+        break;
+
+    case 'S': // stream start
+        m_stream_xid = m_parser.parse_op_stream_start();
+        set_xid(m_stream_xid);
+        m_in_stream = true;
+        break;
+
+    case 'E': // stream stop
+        m_in_stream = false;
+        break;
+
+    case 'c': { // stream commit
+        auto const xid = m_parser.parse_op_stream_commit();
+        set_xid(xid);
+        auto const size = m_data.size();
+        bool const actual_data = m_streams.commit(xid, &m_data);
+        finish_transaction(lsn_text, lsn, m_data.size() != size,
+                           actual_data);
+        break;
+    }
+
+    case 'A': { // stream abort
+        auto const [xid, subxid] = m_parser.parse_op_stream_abort();
+        m_streams.abort(xid, subxid);
+        break;
+    }
+
+    case 'R': // relation (pg table metadata)
+        if (m_in_stream) {
+            m_parser.parse_xid();
+        }
+        m_parser.parse_op_relation();
+        break;
+
+    case 'I': // insert
+    case 'U': // update
+        if (m_in_stream) {
+            auto const subxid = m_parser.parse_xid();
+            m_line.clear();
+            append_change(&m_line, lsn_text, lsn, op);
+            m_streams.add(m_stream_xid, subxid, m_line, op == 'I');
+            break;
+        }
+        append_change(&m_data, lsn_text, lsn, op);
+        m_data_in_current_transaction = true;
+        if (op == 'I') {
+            m_actual_data_in_current_transaction = true;
+        }
+        break;
+
+    default: // skip other operations
+        break;
+    }
+}
+
+void log_builder::add_message(std::string_view lsn, std::string_view message)
+{
+    std::uint64_t value = 0;
+    if (m_format == log_format::records && writes_lsn(message)) {
+        value = lsn_type{lsn}.value();
+    }
+    add(lsn, value, message);
+}
+
+void log_builder::add_message(lsn_type lsn, std::string_view message)
+{
+    std::string_view text;
+    if (m_format == log_format::text && writes_lsn(message)) {
+        text = lsn.format(m_lsn_buffer.data());
+    }
+    add(text, lsn.value(), message);
+}
+
+void log_builder::clear_committed()
+{
+    m_data.erase(0, m_committed_size);
+    m_committed_size = 0;
+    m_has_actual_data = false;
+    m_has_commits = false;
+}
+
+void log_builder::clear_data() noexcept
+{
+    m_data.clear();
+    m_committed_size = 0;
+}
+
+std::string log_builder::take_data() noexcept
+{
+    std::string result;
+    result.swap(m_data);
+    m_committed_size = 0;
     return result;
 }
 
@@ -1,19 +1,28 @@
 #pragma once
 
+#include "binlog.hpp"
 #include "db.hpp"
+#include "lsn.hpp"
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace pgoutput {
 
 // subset of column numbers for columns we're interested in
 struct relevant_table_columns
 {
+    int32_t relation_id{};
     std::string relation_name; // nodes, ways or relations
     char object_type{};        // n = node, w = way, r = relation'
     int osm_object_column{};
@@ -22,7 +31,27 @@ struct relevant_table_columns
     int redaction_column{};
 };
 
-using rel_id_relevant_columns = std::map<int32_t, relevant_table_columns>;
+// There are only a few relations in the publication, so a small vector
+// searched linearly is faster than any map.
+using rel_id_relevant_columns = std::vector<relevant_table_columns>;
+
+// Value of a column in text format or, if the binary option of pgoutput
+// is used, in the binary format of the column type.
+struct column_value
+{
+    std::string_view data;
+    bool binary = false;
+};
+
+// Values of the relevant columns of a tuple, pointing into the message.
+// Null (and unchanged TOAST) values are represented by std::nullopt.
+struct tuple_view
+{
+    std::optional<column_value> osm_object;
+    std::optional<column_value> changeset;
+    std::optional<column_value> version;
+    std::optional<column_value> redaction;
+};
 
 struct row_low_level_parser
 {
@@ -36,11 +65,17 @@ struct row_low_level_parser
     template <typename T>
     T read();
 
-    std::string read_string();
+    std::string_view read_string();
+
+    std::string_view read_string(uint32_t len);
 
-    std::string read_string(uint32_t len);
+    /**
+     * Walk over the TupleData at the current position, only remembering
+     * the columns listed in columns. Nothing is copied or allocated.
+     */
+    tuple_view read_tuple_data(relevant_table_columns const &columns);
 
-    std::vector<std::optional<std::string>> read_tuple_data();
+    void skip_tuple_data();
 
 private:
     // pgoutput data is provided in network byte order (big endian)
@@ -66,15 +101,236 @@ public:
 
     unsigned char parse_op();
 
+    uint32_t parse_op_begin();
+
+    // Read the xid sent in front of changes of streamed transactions
+    uint32_t parse_xid();
+
+    // Returns the xid of the (toplevel) transaction
+    uint32_t parse_op_stream_start();
+
+    // Returns the xid of the (toplevel) transaction
+    uint32_t parse_op_stream_commit();
+
+    // Returns the xids of the toplevel transaction and the subtransaction
+    std::pair<uint32_t, uint32_t> parse_op_stream_abort();
+
     void parse_op_relation();
 
-    std::string parse_op_insert();
+    // Append log line for insert to result
+    void parse_op_insert(std::string *result);
+
+    // Append log line for update to result
+    void parse_op_update(std::string *result);
 
-    std::string parse_op_update();
+    // Fill in the fields of the record for an insert except lsn and xid
+    void parse_op_insert(blog::record *rec);
+
+    // Fill in the fields of the record for an update except lsn and xid
+    void parse_op_update(blog::record *rec);
 
 private:
+    relevant_table_columns const &columns_for(int32_t relation_id);
+
     row_low_level_parser m_msg;
     rel_id_relevant_columns m_relevant_columns_per_rel_id;
+    std::size_t m_last_relation = 0; // index of last relation looked up
+};
+
+/**
+ * @brief Log lines of streamed transactions which are still in progress
+ *
+ * With pgoutput protocol version 2 and streaming enabled, the changes of
+ * large transactions are sent in chunks before the transaction commits.
+ * Their lines are kept here per (toplevel) xid until the Stream Commit or
+ * Stream Abort message arrives. If the lines of a transaction get larger
+ * than the spill size, they are moved to a temporary file.
+ */
+class stream_store
+{
+public:
+    static constexpr std::size_t const default_spill_size =
+        64UL * 1024UL * 1024UL;
+
+    explicit stream_store(std::size_t spill_size = default_spill_size)
+    : m_spill_size(spill_size)
+    {
+    }
+
+    /**
+     * Add a log line for a change made by the subtransaction subxid of
+     * transaction xid. Set actual_data for new objects.
+     */
+    void add(uint32_t xid, uint32_t subxid, std::string_view line,
+             bool actual_data);
+
+    /**
+     * Append all lines of transaction xid to out and forget about it.
+     *
+     * @returns true if the transaction contained any new objects.
+     */
+    bool commit(uint32_t xid, std::string *out);
+
+    /**
+     * Forget the lines of an aborted subtransaction. If subxid is the
+     * same as xid, the whole transaction was aborted.
+     */
+    void abort(uint32_t xid, uint32_t subxid);
+
+    /// Number of transactions in progress.
+    [[nodiscard]] std::size_t size() const noexcept
+    {
+        return m_transactions.size();
+    }
+
+private:
+    struct file_closer
+    {
+        void operator()(std::FILE *file) const noexcept { std::fclose(file); }
+    };
+
+    // Consecutive lines written by the same subtransaction
+    struct run
+    {
+        uint32_t subxid;
+        std::size_t offset;
+        std::size_t inserts;
+    };
+
+    struct transaction
+    {
+        std::unique_ptr<std::FILE, file_closer> spill_file;
+        std::size_t spilled = 0; // bytes in the spill file
+        std::string data;        // lines not spilled yet
+        std::vector<run> runs;
+    };
+
+    void append(transaction *txn, uint32_t subxid, std::string_view data,
+                std::size_t inserts);
+
+    static void read(transaction const &txn, std::size_t offset,
+                     std::size_t size, std::string *out);
+
+    std::map<uint32_t, transaction> m_transactions;
+    std::size_t m_spill_size;
+
+}; // class stream_store
+
+/// Format of the data built by the log_builder.
+enum class log_format
+{
+    text,   // lines of the text log format
+    records // blog::record structs of the binary log format
+};
+
+/**
+ * @brief Decodes a sequence of pgoutput messages into log file lines
+ *
+ * Lines are only added for transactions with actual changes. The xid is
+ * taken from the Begin message of each transaction. Everything up to the
+ * last Commit message seen is available as committed data.
+ *
+ * With log_format::records the data consists of the records of the binary
+ * log format instead of text lines, everything else stays the same.
+ *
+ * Transactions streamed while in progress (pgoutput protocol version 2)
+ * are kept in a stream_store and added to the data when they commit.
+ */
+class log_builder
+{
+public:
+    log_builder() = default;
+
+    /**
+     * Streamed transactions are spilled to disk if their log lines get
+     * larger than stream_spill_size bytes.
+     */
+    explicit log_builder(std::size_t stream_spill_size,
+                         log_format format = log_format::text)
+    : m_streams(stream_spill_size), m_format(format)
+    {
+    }
+
+    /**
+     * Decode a single pgoutput message with the given LSN. For records the
+     * LSN is only parsed for messages which write it into the log.
+     */
+    void add_message(std::string_view lsn, std::string_view message);
+
+    /**
+     * Decode a single pgoutput message with the given LSN. For text the
+     * LSN is only formatted for messages which write it into the log.
+     */
+    void add_message(lsn_type lsn, std::string_view message);
+
+    void reserve(std::size_t size) { m_data.reserve(size); }
+
+    /// LSN of the last commit seen, empty if there was none yet.
+    [[nodiscard]] std::string const &lsn() const noexcept { return m_lsn; }
+
+    /// All log lines, including those of a transaction in progress.
+    [[nodiscard]] std::string_view data() const noexcept { return m_data; }
+
+    /// Log lines of all committed transactions.
+    [[nodiscard]] std::string_view committed_data() const noexcept
+    {
+        return {m_data.data(), m_committed_size};
+    }
+
+    /// Did the committed data contain any new objects?
+    [[nodiscard]] bool has_actual_data() const noexcept
+    {
+        return m_has_actual_data;
+    }
+
+    /// Have there been any Commit messages since the last clear?
+    [[nodiscard]] bool has_commits() const noexcept { return m_has_commits; }
+
+    /**
+     * Remove committed data, keeping lines of a transaction still in
+     * progress.
+     */
+    void clear_committed();
+
+    /**
+     * Remove all log lines, including those of a transaction in progress,
+     * after they have been written out. Commit state is kept.
+     */
+    void clear_data() noexcept;
+
+    /// Move all log lines out, like data() followed by clear_data().
+    [[nodiscard]] std::string take_data() noexcept;
+
+private:
+    // Either lsn_text (for text) or lsn (for records) has to be set for
+    // changes and commits.
+    void add(std::string_view lsn_text, std::uint64_t lsn,
+             std::string_view message);
+
+    void set_xid(uint32_t xid);
+
+    void append_change(std::string *out, std::string_view lsn_text,
+                       std::uint64_t lsn, unsigned char op);
+
+    void finish_transaction(std::string_view lsn_text, std::uint64_t lsn,
+                            bool data, bool actual_data);
+
+    parser m_parser;
+    stream_store m_streams;
+    std::string m_data;
+    std::string m_line;
+    std::string m_lsn;
+    std::string m_xid;
+    uint32_t m_xid_value = 0;
+    std::array<char, lsn_type::format_buffer_size> m_lsn_buffer{};
+    uint32_t m_stream_xid = 0;
+    log_format m_format = log_format::text;
+    bool m_in_stream = false;
+    std::size_t m_committed_size = 0;
+    bool m_data_in_current_transaction = false;
+    bool m_actual_data_in_current_transaction = false;
+    bool m_has_actual_data = false;
+    bool m_has_commits = false;
 };
 
 } // namespace pgoutput
\ No newline at end of file
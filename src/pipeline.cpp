@@ -0,0 +1,232 @@
+#include "pipeline.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+uint32_t relation_id(std::string_view message)
+{
+    if (message.size() < 5) {
+        throw std::runtime_error{"Truncated pgoutput relation message"};
+    }
+
+    uint32_t id = 0;
+    for (std::size_t i = 1; i < 5; ++i) {
+        id = (id << 8U) | static_cast<unsigned char>(message[i]);
+    }
+    return id;
+}
+
+} // anonymous namespace
+
+void message_chunk::add(std::string_view lsn, std::string_view message)
+{
+    m_data.append(lsn);
+    m_data.append(message);
+    m_sizes.emplace_back(lsn.size(), message.size());
+}
+
+void message_chunk::decode(pgoutput::log_builder *builder) const
+{
+    // Relation messages outside a transaction don't create any log lines
+    for (auto const &relation : m_relations) {
+        builder->add_message("0/0", relation);
+    }
+
+    std::string_view const data{m_data};
+    std::size_t offset = 0;
+    for (auto const &[lsn_size, message_size] : m_sizes) {
+        builder->add_message(data.substr(offset, lsn_size),
+                             data.substr(offset + lsn_size, message_size));
+        offset += lsn_size + message_size;
+    }
+}
+
+parallel_decoder::parallel_decoder(unsigned int threads,
+                                   std::size_t buffer_size,
+                                   output_func output,
+                                   pgoutput::log_format format)
+: m_tasks(threads), m_max_pending(2UL * threads), m_buffer_size(buffer_size),
+  // All chunks in flight and their log data fit into the buffer
+  m_chunk_size(std::max<std::size_t>(buffer_size / (4UL * threads), 1)),
+  m_output(std::move(output)), m_format(format)
+{
+    try {
+        for (unsigned int i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this] {
+                while (auto task = m_tasks.pop()) {
+                    (*task)();
+                }
+            });
+        }
+    } catch (...) {
+        m_tasks.close();
+        for (auto &worker : m_workers) {
+            worker.join();
+        }
+        throw;
+    }
+}
+
+parallel_decoder::~parallel_decoder()
+{
+    m_tasks.close();
+    for (auto &worker : m_workers) {
+        worker.join();
+    }
+}
+
+parallel_decoder::decoded_chunk
+parallel_decoder::collect(pgoutput::log_builder *builder)
+{
+    decoded_chunk chunk;
+    chunk.lsn = builder->lsn();
+    chunk.has_commits = builder->has_commits();
+    chunk.has_actual_data = builder->has_actual_data();
+    chunk.data = builder->take_data();
+    return chunk;
+}
+
+void parallel_decoder::remember_relation(std::string_view message)
+{
+    auto const id = relation_id(message);
+
+    // Relation metadata is sent again if the table changes
+    for (auto &relation : m_relations) {
+        if (relation_id(relation) == id) {
+            relation = message;
+            return;
+        }
+    }
+    m_relations.emplace_back(message);
+}
+
+void parallel_decoder::add_message(std::string_view lsn,
+                                   std::string_view message)
+{
+    ++m_result.entries;
+
+    switch (message.empty() ? '\0' : message[0]) {
+    case 'B':
+        m_in_transaction = true;
+        break;
+    case 'C':
+        m_in_transaction = false;
+        break;
+    case 'R':
+        remember_relation(message);
+        break;
+    case 'S':
+    case 'E':
+    case 'c':
+    case 'A':
+        throw std::runtime_error{
+            "Streamed transactions can not be decoded in parallel"};
+    default:
+        break;
+    }
+
+    if (m_direct) {
+        m_direct->add_message(lsn, message);
+        if (!m_in_transaction) {
+            finish_direct_decoding();
+        } else if (m_direct->data().size() >= m_chunk_size) {
+            m_output(m_direct->take_data());
+        }
+        return;
+    }
+
+    m_chunk.add(lsn, message);
+    if (m_chunk.bytes() < m_chunk_size) {
+        return;
+    }
+
+    if (!m_in_transaction) {
+        submit_chunk();
+    } else if (m_chunk.bytes() >= 2 * m_chunk_size) {
+        start_direct_decoding();
+    }
+}
+
+void parallel_decoder::submit_chunk()
+{
+    if (m_chunk.empty()) {
+        return;
+    }
+
+    if (m_pending.size() >= m_max_pending) {
+        output_oldest_chunk();
+    }
+
+    std::packaged_task<decoded_chunk()> task{
+        [chunk = std::move(m_chunk), spill_size = m_buffer_size,
+         format = m_format] {
+            pgoutput::log_builder builder{spill_size, format};
+            chunk.decode(&builder);
+            return collect(&builder);
+        }};
+    m_pending.push_back(task.get_future());
+    m_tasks.push(std::move(task));
+
+    m_chunk = message_chunk{m_relations};
+}
+
+void parallel_decoder::output_chunk(decoded_chunk &&chunk)
+{
+    if (chunk.has_commits) {
+        m_result.lsn = std::move(chunk.lsn);
+    }
+    m_result.has_actual_data =
+        m_result.has_actual_data || chunk.has_actual_data;
+
+    if (!chunk.data.empty()) {
+        m_output(std::move(chunk.data));
+    }
+}
+
+void parallel_decoder::output_oldest_chunk()
+{
+    // Rethrows exceptions from the worker
+    auto chunk = m_pending.front().get();
+    m_pending.pop_front();
+    output_chunk(std::move(chunk));
+}
+
+void parallel_decoder::start_direct_decoding()
+{
+    while (!m_pending.empty()) {
+        output_oldest_chunk();
+    }
+
+    m_direct =
+        std::make_unique<pgoutput::log_builder>(m_buffer_size, m_format);
+    m_chunk.decode(m_direct.get());
+    m_chunk = message_chunk{{}};
+
+    if (m_direct->data().size() >= m_chunk_size) {
+        m_output(m_direct->take_data());
+    }
+}
+
+void parallel_decoder::finish_direct_decoding()
+{
+    output_chunk(collect(m_direct.get()));
+    m_direct.reset();
+    m_chunk = message_chunk{m_relations};
+}
+
+decode_result parallel_decoder::finish()
+{
+    if (m_direct) {
+        finish_direct_decoding();
+    } else {
+        submit_chunk();
+    }
+
+    while (!m_pending.empty()) {
+        output_oldest_chunk();
+    }
+
+    return m_result;
+}
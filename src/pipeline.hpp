@@ -0,0 +1,260 @@
+#pragma once
+
+#include "pgoutput.hpp"
+#include "queue.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Summary of the changes decoded by decode_log().
+struct decode_result
+{
+    std::size_t entries = 0;      // number of pgoutput messages
+    std::string lsn;              // LSN of the last commit
+    bool has_actual_data = false; // any new objects?
+};
+
+/**
+ * Messages of complete transactions which are decoded together by one
+ * worker thread of the parallel_decoder. The Relation messages seen
+ * before the chunk started are decoded first, so the worker has the same
+ * relation metadata as a decoder running through all messages.
+ */
+class message_chunk
+{
+public:
+    explicit message_chunk(std::vector<std::string> relations)
+    : m_relations(std::move(relations))
+    {
+    }
+
+    void add(std::string_view lsn, std::string_view message);
+
+    /// Size of the messages in the chunk in bytes.
+    [[nodiscard]] std::size_t bytes() const noexcept { return m_data.size(); }
+
+    [[nodiscard]] bool empty() const noexcept { return m_sizes.empty(); }
+
+    /// Add all messages including the relations to the builder.
+    void decode(pgoutput::log_builder *builder) const;
+
+private:
+    std::vector<std::string> m_relations;
+    std::string m_data; // LSNs and messages
+    std::vector<std::pair<std::size_t, std::size_t>> m_sizes;
+
+}; // class message_chunk
+
+/**
+ * Decodes pgoutput messages on several threads. Messages are collected
+ * in chunks ending at transaction boundaries, which are decoded by a pool
+ * of worker threads. The log data of the chunks is handed to the output
+ * function in the original order, so it is the same as if all messages
+ * went through a single pgoutput::log_builder.
+ *
+ * A transaction larger than the chunk size is decoded in the calling
+ * thread, so memory use stays limited. Streamed transactions (pgoutput
+ * protocol version 2) are not supported.
+ */
+class parallel_decoder
+{
+public:
+    using output_func = std::function<void(std::string &&)>;
+
+    parallel_decoder(unsigned int threads, std::size_t buffer_size,
+                     output_func output,
+                     pgoutput::log_format format = pgoutput::log_format::text);
+
+    parallel_decoder(parallel_decoder const &) = delete;
+    parallel_decoder(parallel_decoder &&) = delete;
+
+    parallel_decoder &operator=(parallel_decoder const &) = delete;
+    parallel_decoder &operator=(parallel_decoder &&) = delete;
+
+    ~parallel_decoder();
+
+    void add_message(std::string_view lsn, std::string_view message);
+
+    /// Decode everything still in progress and return the summary.
+    decode_result finish();
+
+private:
+    struct decoded_chunk
+    {
+        std::string data;
+        std::string lsn;
+        bool has_commits = false;
+        bool has_actual_data = false;
+    };
+
+    static decoded_chunk collect(pgoutput::log_builder *builder);
+
+    void remember_relation(std::string_view message);
+
+    void submit_chunk();
+
+    void output_chunk(decoded_chunk &&chunk);
+
+    void output_oldest_chunk();
+
+    void start_direct_decoding();
+
+    void finish_direct_decoding();
+
+    bounded_queue<std::packaged_task<decoded_chunk()>> m_tasks;
+    std::vector<std::thread> m_workers;
+    std::deque<std::future<decoded_chunk>> m_pending;
+    std::size_t m_max_pending;
+    std::size_t m_buffer_size;
+    std::size_t m_chunk_size;
+    output_func m_output;
+    pgoutput::log_format m_format;
+    std::vector<std::string> m_relations;
+    message_chunk m_chunk{{}};
+    std::unique_ptr<pgoutput::log_builder> m_direct;
+    decode_result m_result;
+    bool m_in_transaction = false;
+
+}; // class parallel_decoder
+
+namespace detail {
+
+// Number of batches and pieces of log data in flight between the threads
+constexpr std::size_t const pipeline_queue_size = 4;
+
+template <typename TBatch>
+void add_batch(pgoutput::log_builder *builder, TBatch const &batch,
+               decode_result *result)
+{
+    for (int row = 0; row < batch.size(); ++row) {
+        builder->add_message(batch.get(row, 0), batch.get(row, 1));
+    }
+    result->entries += static_cast<std::size_t>(batch.size());
+}
+
+} // namespace detail
+
+/**
+ * Decode pgoutput messages into log data.
+ *
+ * fetch() is called to get batches of messages until it returns a batch
+ * converting to false. A batch has size() and get(row, column) with the
+ * LSN in column 0 and the message in column 1 like a pq::result.
+ *
+ * The log data is handed to write() in pieces, so there is never more
+ * than about buffer_size bytes of it in memory. The last piece can
+ * contain the lines of an uncommitted transaction.
+ *
+ * If pipelined is set, fetching and writing run in their own threads,
+ * connected to the decoding by bounded queues, so the network, the CPU
+ * and the disk are busy at the same time. With more than one decode
+ * thread, decoding is done by a parallel_decoder in addition.
+ *
+ * The log data is in the given format, pieces always contain complete
+ * lines or records.
+ */
+template <typename TFetch, typename TWrite>
+decode_result
+decode_log(TFetch &&fetch, TWrite &&write, std::size_t buffer_size,
+           bool pipelined, unsigned int decode_threads = 1,
+           pgoutput::log_format format = pgoutput::log_format::text)
+{
+    pgoutput::log_builder builder{buffer_size, format};
+    decode_result result;
+
+    if (!pipelined) {
+        while (auto const batch = fetch()) {
+            detail::add_batch(&builder, batch, &result);
+            if (builder.data().size() >= buffer_size) {
+                write(builder.data());
+                builder.clear_data();
+            }
+        }
+        write(builder.data());
+        builder.clear_data();
+
+        result.lsn = builder.lsn();
+        result.has_actual_data = builder.has_actual_data();
+        return result;
+    }
+
+    using batch_type = decltype(fetch());
+    bounded_queue<batch_type> batches{detail::pipeline_queue_size};
+    bounded_queue<std::string> pieces{detail::pipeline_queue_size};
+
+    // All pieces in the queue and the one being built fit into the buffer
+    std::size_t const piece_size =
+        std::max<std::size_t>(buffer_size / (detail::pipeline_queue_size + 1),
+                              1);
+
+    auto fetcher = std::async(std::launch::async, [&] {
+        queue_closer<batch_type> const closer{&batches};
+        while (auto batch = fetch()) {
+            if (!batches.push(std::move(batch))) {
+                return;
+            }
+        }
+    });
+
+    auto writer = std::async(std::launch::async, [&] {
+        queue_closer<std::string> const closer{&pieces};
+        while (auto const piece = pieces.pop()) {
+            write(*piece);
+        }
+    });
+
+    {
+        queue_closer<batch_type> const batches_closer{&batches};
+        queue_closer<std::string> const pieces_closer{&pieces};
+
+        if (decode_threads > 1) {
+            bool stopped = false;
+            parallel_decoder decoder{decode_threads, buffer_size,
+                                     [&](std::string &&data) {
+                                         if (!pieces.push(std::move(data))) {
+                                             stopped = true;
+                                         }
+                                     },
+                                     format};
+            while (!stopped) {
+                auto const batch = batches.pop();
+                if (!batch) {
+                    break;
+                }
+                for (int row = 0; row < batch->size(); ++row) {
+                    decoder.add_message(batch->get(row, 0),
+                                        batch->get(row, 1));
+                }
+            }
+            result = decoder.finish();
+        } else {
+            while (auto const batch = batches.pop()) {
+                detail::add_batch(&builder, *batch, &result);
+                if (builder.data().size() >= piece_size) {
+                    if (!pieces.push(builder.take_data())) {
+                        break;
+                    }
+                    builder.reserve(piece_size);
+                }
+            }
+            pieces.push(builder.take_data());
+            result.lsn = builder.lsn();
+            result.has_actual_data = builder.has_actual_data();
+        }
+    }
+
+    // Rethrows exceptions from the threads
+    fetcher.get();
+    writer.get();
+
+    return result;
+}
@@ -0,0 +1,207 @@
+#include "pq.hpp"
+#include "exception.hpp"
+
+#include <string>
+#include <vector>
+
+namespace pq {
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+namespace {
+
+constexpr int const rows_per_chunk = 1000;
+
+} // anonymous namespace
+#endif
+
+int result::column_number(char const *name) const
+{
+    int const col = PQfnumber(m_res, name);
+    if (col < 0) {
+        throw database_error{std::string{"Unknown column in result: "} +
+                             name};
+    }
+    return col;
+}
+
+connection::connection(std::string const &conninfo)
+: m_conn(PQconnectdb(conninfo.c_str()))
+{
+    if (PQstatus(m_conn) != CONNECTION_OK) {
+        std::string msg{"Connecting to database failed: "};
+        msg += error_message();
+        PQfinish(m_conn);
+        throw database_error{msg};
+    }
+}
+
+connection::~connection() noexcept { PQfinish(m_conn); }
+
+std::string connection::error_message() const
+{
+    std::string msg{PQerrorMessage(m_conn)};
+    while (!msg.empty() && msg.back() == '\n') {
+        msg.pop_back();
+    }
+    return msg;
+}
+
+result connection::exec(std::string const &query, ExecStatusType expected)
+{
+    result res{PQexec(m_conn, query.c_str())};
+
+    if (res.status() != expected) {
+        throw database_error{"Query failed: " + error_message()};
+    }
+
+    return res;
+}
+
+result connection::exec_params(std::string const &query,
+                               std::vector<std::string> const &params,
+                               bool binary_result, ExecStatusType expected)
+{
+    std::vector<char const *> values;
+    values.reserve(params.size());
+    for (auto const &param : params) {
+        values.push_back(param.c_str());
+    }
+
+    result res{PQexecParams(m_conn, query.c_str(),
+                            static_cast<int>(values.size()), nullptr,
+                            values.data(), nullptr, nullptr,
+                            binary_result ? 1 : 0)};
+
+    if (res.status() != expected) {
+        throw database_error{"Query failed: " + error_message()};
+    }
+
+    return res;
+}
+
+void connection::send_query_params(std::string const &query,
+                                   std::vector<std::string> const &params,
+                                   bool binary_result)
+{
+    std::vector<char const *> values;
+    values.reserve(params.size());
+    for (auto const &param : params) {
+        values.push_back(param.c_str());
+    }
+
+    if (!PQsendQueryParams(m_conn, query.c_str(),
+                           static_cast<int>(values.size()), nullptr,
+                           values.data(), nullptr, nullptr,
+                           binary_result ? 1 : 0)) {
+        throw database_error{"Query failed: " + error_message()};
+    }
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    if (!PQsetChunkedRowsMode(m_conn, rows_per_chunk)) {
+#else
+    if (!PQsetSingleRowMode(m_conn)) {
+#endif
+        throw database_error{"Can not switch to row-by-row mode: " +
+                             error_message()};
+    }
+}
+
+result connection::get_result()
+{
+    result res{PQgetResult(m_conn)};
+
+    if (res && res.status() != PGRES_TUPLES_OK &&
+#ifdef LIBPQ_HAS_CHUNK_MODE
+        res.status() != PGRES_TUPLES_CHUNK &&
+#endif
+        res.status() != PGRES_SINGLE_TUPLE) {
+        // Consume the rest, so the connection can be used again
+        while (PGresult *rest = PQgetResult(m_conn)) {
+            PQclear(rest);
+        }
+        throw database_error{"Query failed: " + error_message()};
+    }
+
+    return res;
+}
+
+row_stream::row_stream(connection *conn, std::string const &query,
+                       std::vector<std::string> const &params)
+: m_conn(conn)
+{
+    m_conn->send_query_params(query, params, true);
+    fetch();
+}
+
+row_stream::~row_stream() noexcept
+{
+    m_result = result{nullptr};
+    while (PGresult *rest = PQgetResult(m_conn->get())) {
+        PQclear(rest);
+    }
+}
+
+void row_stream::fetch()
+{
+    m_result = m_conn->get_result();
+    m_row = 0;
+
+    // Only the last piece has no rows. It is kept for column_number(),
+    // after it there are no more results.
+    if (m_result.empty()) {
+        while (PGresult *rest = PQgetResult(m_conn->get())) {
+            PQclear(rest);
+        }
+    }
+}
+
+void row_stream::next()
+{
+    if (++m_row < m_result.size()) {
+        return;
+    }
+
+    fetch();
+}
+
+cursor::cursor(connection *conn, std::string const &name,
+               std::string const &query,
+               std::vector<std::string> const &params, int rows_per_fetch)
+: m_conn(conn),
+  m_fetch("FETCH FORWARD " + std::to_string(rows_per_fetch) + " FROM " +
+          name),
+  m_close("CLOSE " + name), m_rows_per_fetch(rows_per_fetch)
+{
+    m_conn->exec_params("DECLARE " + name + " NO SCROLL CURSOR FOR " + query,
+                        params, false, PGRES_COMMAND_OK);
+    fetch();
+}
+
+cursor::~cursor() noexcept
+{
+    // Errors are ignored, if the transaction failed the cursor is gone
+    // anyway.
+    PQclear(PQexec(m_conn->get(), m_close.c_str()));
+}
+
+void cursor::fetch()
+{
+    // With the extended query protocol the result format of FETCH is set
+    // by the FETCH, not by the DECLARE.
+    m_result = m_conn->exec_params(m_fetch, {}, true);
+    m_row = 0;
+}
+
+void cursor::next()
+{
+    if (++m_row < m_result.size()) {
+        return;
+    }
+
+    // A short chunk is the last one
+    if (m_result.size() == m_rows_per_fetch) {
+        fetch();
+    }
+}
+
+} // namespace pq
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "exception.hpp"
+
+#include <libpq-fe.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Thin RAII wrappers around the libpq C API. They are used where libpqxx
+ * doesn't give us access to the protocol features we need, like replication
+ * connections and results in binary format.
+ */
+namespace pq {
+
+/**
+ * Decode an integer column of a result in binary format. PostgreSQL
+ * sends them in network byte order (big endian). Returns false if the
+ * size of the data doesn't fit the type.
+ */
+template <typename T>
+bool from_binary(std::string_view data, T *value) noexcept
+{
+    if (data.size() != sizeof(T)) {
+        return false;
+    }
+
+    using T_unsigned = std::make_unsigned_t<T>;
+    T_unsigned result = 0;
+    for (char const c : data) {
+        result = static_cast<T_unsigned>(
+            (result << 8U) | static_cast<T_unsigned>(static_cast<unsigned char>(c)));
+    }
+    *value = static_cast<T>(result);
+
+    return true;
+}
+
+/**
+ * Decode an int8 column of a result in binary format.
+ *
+ * @throws database_error if the data has the wrong size.
+ */
+[[nodiscard]] inline std::int64_t int64_from_binary(std::string_view data)
+{
+    std::int64_t value = 0;
+    if (!from_binary(data, &value)) {
+        throw database_error{"Unexpected size of integer column in result"};
+    }
+    return value;
+}
+
+class result
+{
+public:
+    explicit result(PGresult *res) noexcept : m_res(res) {}
+
+    result(result const &) = delete;
+    result(result &&other) noexcept : m_res(other.m_res)
+    {
+        other.m_res = nullptr;
+    }
+
+    result &operator=(result const &) = delete;
+    result &operator=(result &&other) noexcept
+    {
+        std::swap(m_res, other.m_res);
+        return *this;
+    }
+
+    ~result() noexcept { PQclear(m_res); }
+
+    /// A result is empty if there are no more results from a query.
+    [[nodiscard]] explicit operator bool() const noexcept
+    {
+        return m_res != nullptr;
+    }
+
+    [[nodiscard]] ExecStatusType status() const noexcept
+    {
+        return PQresultStatus(m_res);
+    }
+
+    [[nodiscard]] int size() const noexcept { return PQntuples(m_res); }
+
+    [[nodiscard]] bool empty() const noexcept { return size() == 0; }
+
+    [[nodiscard]] bool is_null(int row, int col) const noexcept
+    {
+        return PQgetisnull(m_res, row, col) != 0;
+    }
+
+    [[nodiscard]] std::string_view get(int row, int col) const noexcept
+    {
+        return {PQgetvalue(m_res, row, col),
+                static_cast<std::size_t>(PQgetlength(m_res, row, col))};
+    }
+
+    /**
+     * Get the number of a column by name.
+     *
+     * @throws database_error if there is no such column.
+     */
+    [[nodiscard]] int column_number(char const *name) const;
+
+private:
+    PGresult *m_res;
+
+}; // class result
+
+class connection
+{
+public:
+    explicit connection(std::string const &conninfo);
+
+    connection(connection const &) = delete;
+    connection(connection &&) = delete;
+
+    connection &operator=(connection const &) = delete;
+    connection &operator=(connection &&) = delete;
+
+    ~connection() noexcept;
+
+    [[nodiscard]] PGconn *get() const noexcept { return m_conn; }
+
+    [[nodiscard]] std::string error_message() const;
+
+    /**
+     * Execute query and throw a database_error if the result status is
+     * not the expected one.
+     */
+    result exec(std::string const &query,
+                ExecStatusType expected = PGRES_TUPLES_OK);
+
+    /**
+     * Execute query with parameters in text format. If binary_result is
+     * set, all columns of the result are returned in binary format, so
+     * bytea columns don't go through hex encoding and decoding.
+     */
+    result exec_params(std::string const &query,
+                       std::vector<std::string> const &params,
+                       bool binary_result = false,
+                       ExecStatusType expected = PGRES_TUPLES_OK);
+
+    /**
+     * Send query with parameters in text format without waiting for the
+     * result. The result rows are then returned by get_result() in small
+     * pieces (in chunked-rows mode if libpq supports it, in single-row
+     * mode otherwise), so they never have to be held in memory all at
+     * once.
+     */
+    void send_query_params(std::string const &query,
+                           std::vector<std::string> const &params,
+                           bool binary_result = false);
+
+    /**
+     * Get the next piece of the result of a query sent with
+     * send_query_params(). Returns an empty result after the last one.
+     * Throws a database_error if the query failed.
+     */
+    result get_result();
+
+private:
+    PGconn *m_conn;
+
+}; // class connection
+
+/**
+ * Sends a query with parameters in text format and returns the rows of the
+ * result in binary format one after the other. Only a small piece of the
+ * result is in memory at any time. The server sends the rows without
+ * waiting for requests, but no other query can be run on the connection
+ * until the stream is at its end or destroyed. Use a cursor to read
+ * several results alternately.
+ *
+ * The rest of the result is read and discarded when the stream is
+ * destroyed early, so the connection can be used again.
+ */
+class row_stream
+{
+public:
+    row_stream(connection *conn, std::string const &query,
+               std::vector<std::string> const &params);
+
+    row_stream(row_stream const &) = delete;
+    row_stream(row_stream &&) = delete;
+
+    row_stream &operator=(row_stream const &) = delete;
+    row_stream &operator=(row_stream &&) = delete;
+
+    ~row_stream() noexcept;
+
+    /// Are we past the last row?
+    [[nodiscard]] bool at_end() const noexcept
+    {
+        return m_row >= m_result.size();
+    }
+
+    /// Go to the next row.
+    void next();
+
+    /// Column of the current row (raw binary data).
+    [[nodiscard]] std::string_view get(int col) const noexcept
+    {
+        return m_result.get(m_row, col);
+    }
+
+    [[nodiscard]] bool is_null(int col) const noexcept
+    {
+        return m_result.is_null(m_row, col);
+    }
+
+    /**
+     * Column of the current row as 64 bit integer.
+     *
+     * @throws database_error if the column has the wrong size.
+     */
+    [[nodiscard]] std::int64_t get_int64(int col) const
+    {
+        return int64_from_binary(get(col));
+    }
+
+    /**
+     * Get the number of a column by name.
+     *
+     * @throws database_error if there is no such column.
+     */
+    [[nodiscard]] int column_number(char const *name) const
+    {
+        return m_result.column_number(name);
+    }
+
+private:
+    void fetch();
+
+    connection *m_conn;
+    result m_result{nullptr};
+    int m_row = 0;
+
+}; // class row_stream
+
+/**
+ * A server-side cursor for a query with parameters in text format. The
+ * rows are fetched in binary format in chunks of a fixed number of rows
+ * and returned one after the other. Only one chunk is in memory at any
+ * time, and unlike a row_stream, several cursors can be read alternately
+ * on the same connection. Each chunk needs a round trip to the server.
+ * The connection must be in a transaction block.
+ *
+ * The cursor is closed when this object is destroyed.
+ */
+class cursor
+{
+public:
+    cursor(connection *conn, std::string const &name,
+           std::string const &query, std::vector<std::string> const &params,
+           int rows_per_fetch);
+
+    cursor(cursor const &) = delete;
+    cursor(cursor &&) = delete;
+
+    cursor &operator=(cursor const &) = delete;
+    cursor &operator=(cursor &&) = delete;
+
+    ~cursor() noexcept;
+
+    /// Are we past the last row?
+    [[nodiscard]] bool at_end() const noexcept
+    {
+        return m_row >= m_result.size();
+    }
+
+    /// Go to the next row.
+    void next();
+
+    /// Column of the current row (raw binary data).
+    [[nodiscard]] std::string_view get(int col) const noexcept
+    {
+        return m_result.get(m_row, col);
+    }
+
+    [[nodiscard]] bool is_null(int col) const noexcept
+    {
+        return m_result.is_null(m_row, col);
+    }
+
+    /**
+     * Get the number of a column by name.
+     *
+     * @throws database_error if there is no such column.
+     */
+    [[nodiscard]] int column_number(char const *name) const
+    {
+        return m_result.column_number(name);
+    }
+
+    /**
+     * Column of the current row as 64 bit integer.
+     *
+     * @throws database_error if the column has the wrong size.
+     */
+    [[nodiscard]] std::int64_t get_int64(int col) const
+    {
+        return int64_from_binary(get(col));
+    }
+
+private:
+    void fetch();
+
+    connection *m_conn;
+    std::string m_fetch;
+    std::string m_close;
+    result m_result{nullptr};
+    int m_rows_per_fetch;
+    int m_row = 0;
+
+}; // class cursor
+
+} // namespace pq
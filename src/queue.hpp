@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <utility>
+
+/**
+ * Queue with limited capacity between producer and consumer threads.
+ * Either side can close it: The producer when there is no more data, the
+ * consumer when it stops early (for instance because of an error), so the
+ * other side doesn't wait forever. Items still in the queue when it is
+ * closed can be popped.
+ */
+template <typename T>
+class bounded_queue
+{
+public:
+    explicit bounded_queue(std::size_t capacity) : m_capacity(capacity) {}
+
+    /**
+     * Add item to the queue, waiting while it is full.
+     *
+     * @returns false if the queue was closed.
+     */
+    bool push(T &&item)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_not_full.wait(lock, [this] {
+            return m_closed || m_items.size() < m_capacity;
+        });
+        if (m_closed) {
+            return false;
+        }
+        m_items.push_back(std::move(item));
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Get the next item from the queue, waiting while it is empty.
+     *
+     * @returns std::nullopt if the queue is closed and empty.
+     */
+    std::optional<T> pop()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_not_empty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty()) {
+            return std::nullopt;
+        }
+        std::optional<T> item{std::move(m_items.front())};
+        m_items.pop_front();
+        m_not_full.notify_one();
+        return item;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> const lock{m_mutex};
+        m_closed = true;
+        m_not_empty.notify_all();
+        m_not_full.notify_all();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_not_empty;
+    std::condition_variable m_not_full;
+    std::deque<T> m_items;
+    std::size_t m_capacity;
+    bool m_closed = false;
+
+}; // class bounded_queue
+
+/// Closes a queue when it goes out of scope, also on exceptions.
+template <typename T>
+class queue_closer
+{
+public:
+    explicit queue_closer(bounded_queue<T> *queue) noexcept : m_queue(queue)
+    {}
+
+    queue_closer(queue_closer const &) = delete;
+    queue_closer(queue_closer &&) = delete;
+
+    queue_closer &operator=(queue_closer const &) = delete;
+    queue_closer &operator=(queue_closer &&) = delete;
+
+    ~queue_closer() { m_queue->close(); }
+
+private:
+    bounded_queue<T> *m_queue;
+
+}; // class queue_closer
@@ -0,0 +1,239 @@
+#include "replication.hpp"
+#include "exception.hpp"
+
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <poll.h>
+
+namespace {
+
+// Replication protocol timestamps are microseconds since 2000-01-01.
+constexpr std::int64_t const pg_epoch_offset_us = 946684800LL * 1000000LL;
+
+std::uint64_t read_uint64(char const *data) noexcept
+{
+    std::uint64_t result = 0;
+    for (unsigned int i = 0; i < 8; ++i) {
+        result = (result << 8U) | static_cast<unsigned char>(data[i]);
+    }
+    return result;
+}
+
+void write_uint64(char *data, std::uint64_t value) noexcept
+{
+    for (unsigned int i = 0; i < 8; ++i) {
+        data[i] = static_cast<char>((value >> (8U * (7 - i))) & 0xffU);
+    }
+}
+
+std::string quote_literal(std::string const &str)
+{
+    std::string result{"'"};
+    for (char const c : str) {
+        if (c == '\'') {
+            result += '\'';
+        }
+        result += c;
+    }
+    result += '\'';
+    return result;
+}
+
+std::string quote_identifier(std::string const &str)
+{
+    std::string result{"\""};
+    for (char const c : str) {
+        if (c == '"') {
+            result += '"';
+        }
+        result += c;
+    }
+    result += '"';
+    return result;
+}
+
+} // anonymous namespace
+
+replication_stream::replication_stream(std::string const &conninfo,
+                                       std::string const &replication_slot,
+                                       std::string const &publication,
+                                       plugin_options options)
+: m_conn(conninfo + " replication=database"),
+  m_replication_slot(replication_slot), m_publication(publication),
+  m_plugin_options(std::move(options))
+{
+}
+
+replication_stream::~replication_stream() noexcept { free_buffer(); }
+
+void replication_stream::free_buffer() noexcept
+{
+    if (m_buffer) {
+        PQfreemem(m_buffer);
+        m_buffer = nullptr;
+    }
+}
+
+void replication_stream::start()
+{
+    std::string query{"START_REPLICATION SLOT "};
+    query += quote_identifier(m_replication_slot);
+    query += " LOGICAL 0/0 (";
+    for (auto const &[name, value] : m_plugin_options) {
+        query += quote_identifier(name);
+        query += ' ';
+        query += quote_literal(value);
+        query += ", ";
+    }
+    query += "publication_names ";
+    query += quote_literal(m_publication);
+    query += ')';
+
+    m_conn.exec(query, PGRES_COPY_BOTH);
+    m_streaming = true;
+}
+
+bool replication_stream::wait_for_input(std::chrono::milliseconds timeout)
+{
+    pollfd pfd{};
+    pfd.fd = PQsocket(m_conn.get());
+    pfd.events = POLLIN;
+
+    int const result = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+    if (result < 0) {
+        if (errno == EINTR) {
+            return false;
+        }
+        throw std::system_error{errno, std::system_category(),
+                                "Waiting for replication stream failed"};
+    }
+
+    return result > 0;
+}
+
+bool replication_stream::read(xlog_data *msg,
+                              std::chrono::milliseconds timeout)
+{
+    free_buffer();
+
+    auto const deadline = std::chrono::steady_clock::now() + timeout;
+
+    while (true) {
+        int const len = PQgetCopyData(m_conn.get(), &m_buffer, 1);
+
+        if (len == 0) {
+            auto const now = std::chrono::steady_clock::now();
+            if (now >= deadline ||
+                !wait_for_input(
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - now))) {
+                return false;
+            }
+            if (PQconsumeInput(m_conn.get()) == 0) {
+                throw database_error{"Reading replication stream failed: " +
+                                     m_conn.error_message()};
+            }
+            continue;
+        }
+
+        if (len == -1) {
+            m_streaming = false;
+            throw database_error{"Replication stream ended by server"};
+        }
+
+        if (len < 0) {
+            throw database_error{"Reading replication stream failed: " +
+                                 m_conn.error_message()};
+        }
+
+        if (m_buffer[0] == 'k') { // primary keepalive message
+            if (len < 18) {
+                throw database_error{"Invalid keepalive message"};
+            }
+            bool const reply_requested = m_buffer[17] != 0;
+            free_buffer();
+            if (reply_requested) {
+                send_status(0);
+            }
+            continue;
+        }
+
+        if (m_buffer[0] == 'w') { // XLogData
+            if (len < 25) {
+                throw database_error{"Invalid XLogData message"};
+            }
+            msg->lsn = read_uint64(m_buffer + 1);
+            msg->data = std::string_view{m_buffer + 25,
+                                         static_cast<std::size_t>(len - 25)};
+            if (msg->lsn > m_received_lsn) {
+                m_received_lsn = msg->lsn;
+            }
+            return true;
+        }
+
+        throw database_error{
+            std::string{"Unexpected message in replication stream: "} +
+            m_buffer[0]};
+    }
+}
+
+void replication_stream::send_status(std::uint64_t flushed_lsn)
+{
+    if (flushed_lsn > m_flushed_lsn) {
+        m_flushed_lsn = flushed_lsn;
+    }
+
+    auto const now = std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count() -
+                     pg_epoch_offset_us;
+
+    // 'r', written LSN, flushed LSN, applied LSN, timestamp, reply request
+    std::array<char, 1 + 4 * 8 + 1> buffer{};
+    buffer[0] = 'r';
+    write_uint64(buffer.data() + 1, m_received_lsn);
+    write_uint64(buffer.data() + 9, m_flushed_lsn);
+    write_uint64(buffer.data() + 17, m_flushed_lsn);
+    write_uint64(buffer.data() + 25, static_cast<std::uint64_t>(now));
+    buffer[33] = 0;
+
+    if (PQputCopyData(m_conn.get(), buffer.data(),
+                      static_cast<int>(buffer.size())) <= 0 ||
+        PQflush(m_conn.get()) != 0) {
+        throw database_error{"Sending status update failed: " +
+                             m_conn.error_message()};
+    }
+}
+
+void replication_stream::stop()
+{
+    if (!m_streaming) {
+        return;
+    }
+    m_streaming = false;
+    free_buffer();
+
+    if (PQputCopyEnd(m_conn.get(), nullptr) <= 0 ||
+        PQflush(m_conn.get()) != 0) {
+        throw database_error{"Ending replication stream failed: " +
+                             m_conn.error_message()};
+    }
+
+    // Drain anything the server sent before it saw our CopyDone. This is
+    // not confirmed and will be sent again next time.
+    while (PQgetCopyData(m_conn.get(), &m_buffer, 0) >= 0) {
+        free_buffer();
+    }
+    free_buffer();
+
+    while (PGresult *res = PQgetResult(m_conn.get())) {
+        PQclear(res);
+    }
+}
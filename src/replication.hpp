@@ -0,0 +1,97 @@
+#pragma once
+
+#include "pq.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Names and values of options for the pgoutput plugin.
+using plugin_options = std::vector<std::pair<std::string, std::string>>;
+
+/**
+ * A pgoutput message received through the streaming replication protocol
+ * together with the LSN it was sent with. The data is only valid until the
+ * next call to replication_stream::read().
+ */
+struct xlog_data
+{
+    std::uint64_t lsn = 0;
+    std::string_view data;
+};
+
+/**
+ * Streams changes from a logical replication slot using the streaming
+ * replication protocol (START_REPLICATION ... LOGICAL in CopyBoth mode).
+ *
+ * https://www.postgresql.org/docs/current/protocol-replication.html
+ */
+class replication_stream
+{
+public:
+    /**
+     * The plugin_options (like proto_version) are passed to pgoutput
+     * together with the publication name.
+     */
+    replication_stream(std::string const &conninfo,
+                       std::string const &replication_slot,
+                       std::string const &publication,
+                       plugin_options options);
+
+    replication_stream(replication_stream const &) = delete;
+    replication_stream(replication_stream &&) = delete;
+
+    replication_stream &operator=(replication_stream const &) = delete;
+    replication_stream &operator=(replication_stream &&) = delete;
+
+    ~replication_stream() noexcept;
+
+    /// Version of the database server as a number like 150004.
+    [[nodiscard]] int server_version() const noexcept
+    {
+        return PQserverVersion(m_conn.get());
+    }
+
+    /**
+     * Start streaming from the confirmed position of the replication slot.
+     */
+    void start();
+
+    /**
+     * Wait up to timeout for the next pgoutput message. Keepalive messages
+     * from the server are handled internally.
+     *
+     * @returns false if there was no message in time.
+     */
+    bool read(xlog_data *msg, std::chrono::milliseconds timeout);
+
+    /**
+     * Send standby status update to the server. The flushed LSN tells the
+     * server that everything up to this point is safely stored and will
+     * not be requested again. Use 0 to not confirm anything.
+     */
+    void send_status(std::uint64_t flushed_lsn);
+
+    /**
+     * End the CopyBoth mode.
+     */
+    void stop();
+
+private:
+    void free_buffer() noexcept;
+
+    bool wait_for_input(std::chrono::milliseconds timeout);
+
+    pq::connection m_conn;
+    std::string m_replication_slot;
+    std::string m_publication;
+    char *m_buffer = nullptr;
+    std::uint64_t m_received_lsn = 0;
+    std::uint64_t m_flushed_lsn = 0;
+    plugin_options m_plugin_options;
+    bool m_streaming = false;
+
+}; // class replication_stream
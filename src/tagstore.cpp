@@ -0,0 +1,35 @@
+#include "tagstore.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+void tag_store::reserve(std::size_t tags)
+{
+    m_tags.reserve(tags);
+    // Most values are short
+    m_values.reserve(tags * 8);
+}
+
+uint32_t tag_store::intern_key(std::string_view key)
+{
+    auto const it = m_key_index.find(key);
+    if (it != m_key_index.end()) {
+        return it->second;
+    }
+
+    auto const index = static_cast<uint32_t>(m_keys.size());
+    m_keys.emplace_back(key);
+    m_key_index.emplace(m_keys.back(), index);
+
+    return index;
+}
+
+void tag_store::add(osmium::object_id_type id,
+                    osmium::object_version_type version, std::string_view key,
+                    std::string_view value)
+{
+    m_tags.push_back(tag{id, m_values.size(), version, intern_key(key),
+                         static_cast<uint32_t>(value.size())});
+    m_values.append(value);
+}
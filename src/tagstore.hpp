@@ -0,0 +1,86 @@
+#pragma once
+
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Storage for the tags of many objects, ordered by object.
+ *
+ * Values are appended to one growing string, the tags only keep offsets
+ * into it. Keys repeat all the time, so they are interned: every key is
+ * stored once and the tags keep an index into the key table. This avoids
+ * two allocations per tag.
+ */
+class tag_store
+{
+public:
+    struct tag
+    {
+        osmium::object_id_type id;
+        std::size_t value_offset;
+        osmium::object_version_type version;
+        uint32_t key;
+        uint32_t value_size;
+    };
+
+    using const_iterator = std::vector<tag>::const_iterator;
+
+    void reserve(std::size_t tags);
+
+    /// Add a tag of the object with the specified id and version.
+    void add(osmium::object_id_type id, osmium::object_version_type version,
+             std::string_view key, std::string_view value);
+
+    [[nodiscard]] std::string_view key(tag const &t) const noexcept
+    {
+        return m_keys[t.key];
+    }
+
+    [[nodiscard]] std::string_view value(tag const &t) const noexcept
+    {
+        return std::string_view{m_values}.substr(t.value_offset,
+                                                 t.value_size);
+    }
+
+    [[nodiscard]] const_iterator begin() const noexcept
+    {
+        return m_tags.begin();
+    }
+
+    [[nodiscard]] const_iterator end() const noexcept { return m_tags.end(); }
+
+    [[nodiscard]] std::size_t size() const noexcept { return m_tags.size(); }
+
+    [[nodiscard]] bool empty() const noexcept { return m_tags.empty(); }
+
+    /// The number of different keys.
+    [[nodiscard]] std::size_t num_keys() const noexcept
+    {
+        return m_keys.size();
+    }
+
+    /// Approximate memory used in bytes, not counting the key table.
+    [[nodiscard]] std::size_t used_memory() const noexcept
+    {
+        return m_tags.capacity() * sizeof(tag) + m_values.capacity();
+    }
+
+private:
+    uint32_t intern_key(std::string_view key);
+
+    std::vector<tag> m_tags;
+    std::string m_values;
+
+    // A deque never moves its elements, so the views in the index stay
+    // valid when new keys are added.
+    std::deque<std::string> m_keys;
+    std::unordered_map<std::string_view, uint32_t> m_key_index;
+
+}; // class tag_store
@@ -1,5 +1,6 @@
 
 #include "util.hpp"
+#include "binlog.hpp"
 #include "io.hpp"
 
 #include <osmium/io/detail/read_write.hpp>
@@ -7,9 +8,11 @@
 
 #include <ctime>
 #include <string>
+#include <string_view>
 
 std::string create_replication_log_name(std::string const &name,
-                                        std::time_t time)
+                                        std::time_t time,
+                                        char const *extension)
 {
     std::string file_name = "osm-repl-";
 
@@ -18,17 +21,38 @@ std::string create_replication_log_name(std::string const &name,
     file_name += now.to_iso_all();
     file_name += '-';
     file_name += name;
-    file_name += ".log";
+    file_name += extension;
 
     return file_name;
 }
 
-void write_data_to_file(std::string const &data, std::string const &dir_name,
-                        std::string const &file_name)
+bool is_log_file_name(std::string_view file_name) noexcept
+{
+    for (std::string_view const suffix :
+         {".log", ".log.gz", ".log.zst", blog::extension}) {
+        if (file_name.size() > suffix.size() &&
+            file_name.substr(file_name.size() - suffix.size()) == suffix) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void write_data_to_file(std::string_view data, std::string const &dir_name,
+                        std::string const &file_name,
+                        compression_type compression)
 {
     std::string const file_name_final{dir_name + file_name};
     std::string const file_name_tmp{file_name_final + ".new"};
 
+    std::string compressed;
+    if (compression != compression_type::none) {
+        compressor comp{compression};
+        compressed = comp.compress(data);
+        compressed += comp.finish();
+        data = compressed;
+    }
+
     int const fd = excl_write_open(file_name_tmp);
 
     osmium::io::detail::reliable_write(fd, data.data(), data.size());
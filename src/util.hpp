@@ -1,5 +1,6 @@
 #pragma once
 
+#include "compression.hpp"
 #include "config.hpp"
 #include "exception.hpp"
 
@@ -10,14 +11,24 @@
 #include <csignal>
 #include <ctime>
 #include <string>
+#include <string_view>
 
 std::string get_time(std::time_t now);
 
 std::string create_replication_log_name(std::string const &name,
-                                        std::time_t time = std::time(nullptr));
-
-void write_data_to_file(std::string const &data, std::string const &dir_name,
-                        std::string const &file_name);
+                                        std::time_t time = std::time(nullptr),
+                                        char const *extension = ".log");
+
+/**
+ * Is this the name of a log file written by osmdbt-get-log or
+ * osmdbt-fake-log which has not been processed yet (in text or binary
+ * format, possibly compressed)?
+ */
+bool is_log_file_name(std::string_view file_name) noexcept;
+
+void write_data_to_file(std::string_view data, std::string const &dir_name,
+                        std::string const &file_name,
+                        compression_type compression = compression_type::none);
 
 template <typename TOptions>
 // NOLINTNEXTLINE(cppcoreguidelines-avoid-c-arrays,hicpp-avoid-c-arrays,modernize-avoid-c-arrays)
@@ -0,0 +1,44 @@
+#!/bin/bash
+#
+#  Test osmdbt-get-log and osmdbt-create-diff with binary log files
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load some test data
+psql --quiet <"$SRCDIR/meta.sql"
+psql --quiet <"$SRCDIR/testdata.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --log-format=binary --catchup
+
+# There should be exactly one binary log file
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+LOGNAME=$(ls "$TESTDIR/log")
+test "${LOGNAME%.blog}" != "$LOGNAME"
+
+# Convert to text and check content
+../src/osmdbt-convert-log --config="$CONFIG" --log="$LOGNAME" --output="$TESTDIR/tmp/log.txt"
+
+test $(wc -l <"$TESTDIR/tmp/log.txt") -eq 7
+grep --quiet ' n10 v1 c1$' "$TESTDIR/tmp/log.txt"
+grep --quiet ' n11 v1 c1$' "$TESTDIR/tmp/log.txt"
+grep --quiet ' n10 v2 c2$' "$TESTDIR/tmp/log.txt"
+grep --quiet ' n11 v2 c2$' "$TESTDIR/tmp/log.txt"
+grep --quiet ' w20 v1 c1$' "$TESTDIR/tmp/log.txt"
+grep --quiet ' r30 v1 c1$' "$TESTDIR/tmp/log.txt"
+
+# Converting back gives the same binary log
+../src/osmdbt-convert-log --config="$CONFIG" --log="$TESTDIR/tmp/log.txt" --output="$TESTDIR/tmp/log.blog"
+cmp "$TESTDIR/log/$LOGNAME" "$TESTDIR/tmp/log.blog"
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=42 --dry-run
+
+zgrep --quiet 'node id="10" version="1"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="11" version="1"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="10" version="2"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="11" version="2"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'way id="20" version="1"'  "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'relation id="30" version="1"'  "$TESTDIR/tmp/new-change.osc.gz"
@@ -8,7 +8,7 @@ set -x
 
 . "$SRCDIR/setup.sh"
 
-for cmd in catchup create-diff disable-replication enable-replication fake-log get-log testdb; do
+for cmd in catchup convert-log create-diff disable-replication enable-replication fake-log get-log testdb; do
     ../src/osmdbt-$cmd -h | grep --quiet '^Usage'
     ../src/osmdbt-$cmd --help | grep --quiet '^Usage'
     test_exit 3 ../src/osmdbt-$cmd --unknown
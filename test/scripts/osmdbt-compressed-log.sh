@@ -0,0 +1,38 @@
+#!/bin/bash
+#
+#  Test osmdbt-get-log and osmdbt-create-diff with compressed log files
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load some test data
+psql --quiet <"$SRCDIR/meta.sql"
+psql --quiet <"$SRCDIR/testdata.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --compression=gzip --catchup
+
+# There should be exactly one compressed log file
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+LOGFILE="$TESTDIR/log/"$(ls "$TESTDIR/log")
+test "${LOGFILE%.log.gz}" != "$LOGFILE"
+
+# Check content of log file
+test $(zcat "$LOGFILE" | wc -l) -eq 7
+zgrep --quiet ' n10 v1 c1$' "$LOGFILE"
+zgrep --quiet ' n11 v1 c1$' "$LOGFILE"
+zgrep --quiet ' n10 v2 c2$' "$LOGFILE"
+zgrep --quiet ' n11 v2 c2$' "$LOGFILE"
+zgrep --quiet ' w20 v1 c1$' "$LOGFILE"
+zgrep --quiet ' r30 v1 c1$' "$LOGFILE"
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=42 --dry-run
+
+zgrep --quiet 'node id="10" version="1"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="11" version="1"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="10" version="2"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'node id="11" version="2"' "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'way id="20" version="1"'  "$TESTDIR/tmp/new-change.osc.gz"
+zgrep --quiet 'relation id="30" version="1"'  "$TESTDIR/tmp/new-change.osc.gz"
@@ -0,0 +1,39 @@
+#!/bin/bash
+#
+#  Test that osmdbt-create-diff writes the same change file regardless of
+#  batches, flushed buffers, and connections
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load enough test data to fill several output buffers
+psql --quiet <"$SRCDIR/meta.sql"
+psql --quiet <"$SRCDIR/testdata-large.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+# Create the change file in the tmp dir and keep a copy
+create_diff() {
+    local name=$1
+    shift
+    ../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=1 --dry-run "$@"
+    zcat "$TESTDIR/tmp/new-change.osc.gz" >"$TESTDIR/$name.osc"
+}
+
+create_diff single --batch-size=100000
+create_diff small --batch-size=7
+create_diff threads --batch-size=1000 --fetch-threads=3
+create_diff aggregate --batch-size=1000 --query-mode=aggregate
+
+test $(grep --count '<node ' "$TESTDIR/single.osc") -eq 20040
+test $(grep --count '<way ' "$TESTDIR/single.osc") -eq 3010
+test $(grep --count '<relation ' "$TESTDIR/single.osc") -eq 10
+
+# Buffers are only written out where the operation changes and blocks
+# continuing in the next batch are merged, so the files are identical
+for name in small threads aggregate; do
+    cmp "$TESTDIR/single.osc" "$TESTDIR/$name.osc"
+done
@@ -0,0 +1,33 @@
+#!/bin/bash
+#
+#  Test osmdbt-create-diff command with small batches and compare result
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load some test data
+psql --quiet <"$SRCDIR/meta.sql"
+psql --quiet <"$SRCDIR/osmdbt-create-diff-compare.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=42 --batch-size=2
+
+CHANGE_FILE="$TESTDIR/changes/000/000/042.osc"
+
+zcat "$CHANGE_FILE.gz" >"$CHANGE_FILE"
+
+# Each batch is written out separately, so an operation block (<create>,
+# <modify>, <delete>) might be closed and opened again at batch boundaries.
+# Merge those blocks before comparing.
+merge_ops() {
+    sed -e ':a' -e 'N' -e '$!ba' \
+        -e 's#  </\(create\|modify\|delete\)>\n  <\1>\n##g' "$1"
+}
+
+diff -u <(merge_ops "$SRCDIR/osmdbt-create-diff-compare.osc") \
+        <(merge_ops "$CHANGE_FILE")
+
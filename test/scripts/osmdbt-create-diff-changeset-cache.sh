@@ -0,0 +1,43 @@
+#!/bin/bash
+#
+#  Test osmdbt-create-diff command with the changeset cache in run_dir
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load some test data
+psql --quiet <"$SRCDIR/meta.sql"
+psql --quiet <"$SRCDIR/testdata.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=42 >"$TESTDIR/out1"
+
+grep --quiet 'Found 0 changesets in cache, reading 2 from database' "$TESTDIR/out1"
+test -f "$TESTDIR/run/osmdbt-changeset-cache"
+zgrep --quiet 'user="testuser1"' "$TESTDIR/changes/000/000/042.osc.gz"
+
+# Changeset 1 is in the cache now, but the user has a new name
+psql --quiet --command="UPDATE users SET display_name = 'renamed1' WHERE id = 1"
+psql --quiet <"$SRCDIR/testdata-more.sql"
+
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=43 >"$TESTDIR/out2"
+
+grep --quiet 'Found 1 changesets in cache, reading 0 from database' "$TESTDIR/out2"
+zgrep --quiet 'user="renamed1"' "$TESTDIR/changes/000/000/043.osc.gz"
+test $(zgrep --count 'user="testuser1"' "$TESTDIR/changes/000/000/043.osc.gz") -eq 0
+
+# A damaged cache is ignored
+echo "garbage" >"$TESTDIR/run/osmdbt-changeset-cache"
+
+LOGFILE=$(ls "$TESTDIR/log" | head -n 1)
+
+../src/osmdbt-create-diff --config="$CONFIG" --sequence-number=44 --dry-run --log-file="$LOGFILE" >"$TESTDIR/out3"
+
+grep --quiet 'Ignoring changeset cache' "$TESTDIR/out3"
+grep --quiet 'Found 0 changesets in cache' "$TESTDIR/out3"
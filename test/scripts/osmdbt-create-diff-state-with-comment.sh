@@ -44,6 +44,7 @@ LOGFILE=$(ls "$TESTDIR/log")
 # Log file should have suffix ".log.done"
 test ${LOGFILE%.log.done}.log.done = "$LOGFILE"
 
-# There should be 6 files in the test directory (config, 2xstate, 1xchange, log)
-test $(find "$TESTDIR" -type f | wc -l) -eq 5
+# There should be 6 files in the test directory (config, 2xstate, 1xchange,
+# log, changeset cache)
+test $(find "$TESTDIR" -type f | wc -l) -eq 6
 
@@ -0,0 +1,58 @@
+#!/bin/bash
+#
+#  Test osmdbt-get-log command in streaming (--follow) mode
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load meta data and catch up on these unrelated changes
+psql --quiet <"$SRCDIR/meta.sql"
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+# Start streaming in the background
+../src/osmdbt-get-log --config="$CONFIG" --catchup --follow &
+PID=$!
+
+# --follow can't be combined with --max-changes or the threading options
+test_exit 3 ../src/osmdbt-get-log --config="$CONFIG" --follow --max-changes=2
+test_exit 3 ../src/osmdbt-get-log --config="$CONFIG" --follow --single-threaded
+test_exit 3 ../src/osmdbt-get-log --config="$CONFIG" --follow --decode-threads=2
+
+# Load some test data
+psql --quiet <"$SRCDIR/testdata.sql"
+
+# Wait for the log file to appear
+for i in $(seq 1 50); do
+    if [ $(ls -1 "$TESTDIR/log" | grep -c '\.log$') -eq 1 ]; then
+        break
+    fi
+    sleep 0.2
+done
+
+# Stop streaming
+kill -TERM $PID
+wait $PID
+
+# There should be exactly one log file
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+
+# Determine name of log file
+LOGFILE="$TESTDIR/log/"$(ls "$TESTDIR/log")
+
+# Check content of log file
+test $(wc -l <"$LOGFILE") -eq 7
+grep --quiet ' n10 v1 c1$' "$LOGFILE"
+grep --quiet ' n11 v1 c1$' "$LOGFILE"
+grep --quiet ' n10 v2 c2$' "$LOGFILE"
+grep --quiet ' n11 v2 c2$' "$LOGFILE"
+grep --quiet ' w20 v1 c1$' "$LOGFILE"
+grep --quiet ' r30 v1 c1$' "$LOGFILE"
+
+# Changes have been confirmed to the server
+../src/osmdbt-testdb -c "$CONFIG" 2>&1 | grep "There are no changes in your configured replication slot."
+
+../src/osmdbt-disable-replication --config="$CONFIG"
+
@@ -0,0 +1,78 @@
+#!/bin/bash
+#
+#  Test osmdbt-get-log command with --streaming when the replication slot
+#  only has chunks of a transaction which is still in progress
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Streaming of in-progress transactions needs PostgreSQL 14+
+if [ "$(psql --tuples-only --no-align --command='SHOW server_version_num')" -lt 140000 ]; then
+    echo "Skipping test, server is too old"
+    exit 0
+fi
+
+# Load meta data and catch up on these unrelated changes
+psql --quiet <"$SRCDIR/meta.sql"
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+# Large transactions are streamed once they use more than this
+psql --quiet --command="ALTER SYSTEM SET logical_decoding_work_mem = '64kB'"
+psql --quiet --command="SELECT pg_reload_conf()"
+
+psql --quiet --command="CREATE TABLE go (x int)"
+
+# Large transaction which waits for a row in table "go" before committing
+psql --quiet <<'SQL' &
+BEGIN;
+INSERT INTO nodes (node_id, version, changeset_id, latitude, longitude, "timestamp", tile, visible)
+    SELECT n, 1, 1, 10000000, 20000000, '2020-02-20T20:20:10Z', 0, true
+        FROM generate_series(1000, 50999) AS n;
+DO $$ BEGIN
+    WHILE NOT EXISTS (SELECT 1 FROM go) LOOP
+        PERFORM pg_sleep(0.1);
+    END LOOP;
+END $$;
+COMMIT;
+SQL
+PID=$!
+
+# Wait until chunks of the transaction are in the replication slot
+for i in $(seq 1 50); do
+    if ../src/osmdbt-get-log --config="$CONFIG" --streaming --max-changes=100 | grep --quiet 'No committed transactions found'; then
+        break
+    fi
+    sleep 0.2
+done
+
+# Nothing is committed yet, there is nothing to write or catch up to
+../src/osmdbt-get-log --config="$CONFIG" --streaming --catchup --max-changes=100 >"$TESTDIR/out"
+grep --quiet 'No committed transactions found' "$TESTDIR/out"
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 0
+
+# Batches without commits are made larger until all changes are read
+../src/osmdbt-get-log --config="$CONFIG" --streaming --catchup --time-budget=60 >"$TESTDIR/out"
+grep --quiet 'has no committed transactions, reading more' "$TESTDIR/out"
+grep --quiet 'Caught up with the replication log' "$TESTDIR/out"
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 0
+
+# Let the transaction commit
+psql --quiet --command="INSERT INTO go VALUES (1)"
+wait $PID
+
+../src/osmdbt-get-log --config="$CONFIG" --streaming --catchup
+
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+LOGFILE="$TESTDIR/log/"$(ls "$TESTDIR/log")
+
+# 50000 nodes and the commit
+test $(wc -l <"$LOGFILE") -eq 50001
+grep --quiet ' n1000 v1 c1$' "$LOGFILE"
+grep --quiet ' n50999 v1 c1$' "$LOGFILE"
+
+../src/osmdbt-testdb -c "$CONFIG" 2>&1 | grep "There are no changes in your configured replication slot."
+
+../src/osmdbt-disable-replication --config="$CONFIG"
@@ -0,0 +1,47 @@
+#!/bin/bash
+#
+#  Test osmdbt-get-log command with --time-budget
+#
+
+set -e
+set -x
+
+. "$SRCDIR/setup.sh"
+
+# Load some test data
+psql --quiet <"$SRCDIR/meta.sql"
+../src/osmdbt-get-log --config="$CONFIG" --catchup
+
+psql --quiet <"$SRCDIR/testdata-2.sql"
+
+# Needs --catchup
+test_exit 3 ../src/osmdbt-get-log --config="$CONFIG" --time-budget=60
+
+# Batch options need --time-budget
+test_exit 3 ../src/osmdbt-get-log --config="$CONFIG" --catchup --batch-changes=10
+
+# --max-changes is the maximum for all batches, the first transaction has
+# more changes than that, so only one batch is read
+../src/osmdbt-get-log --config="$CONFIG" --catchup --time-budget=60 --max-changes=2
+
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+LOGFILE="$TESTDIR/log/"$(ls "$TESTDIR/log")
+
+test $(wc -l <"$LOGFILE") -eq 5
+grep --quiet ' n10 v1 c1$' "$LOGFILE"
+grep --quiet ' n11 v2 c2$' "$LOGFILE"
+
+rm "$LOGFILE"
+
+../src/osmdbt-get-log --config="$CONFIG" --catchup --time-budget=60 --batch-time=1 --batch-changes=1000
+
+# All other changes are in one log file and have been marked as done
+test $(ls -1 "$TESTDIR/log" | wc -l) -eq 1
+LOGFILE="$TESTDIR/log/"$(ls "$TESTDIR/log")
+
+test $(wc -l <"$LOGFILE") -eq 2
+grep --quiet ' w20 v1 c1$' "$LOGFILE"
+
+../src/osmdbt-testdb -c "$CONFIG" 2>&1 | grep "There are no changes in your configured replication slot."
+
+../src/osmdbt-disable-replication --config="$CONFIG"
@@ -0,0 +1,45 @@
+BEGIN;
+
+-- Long run of created nodes, so the output is flushed in the middle of it
+INSERT INTO nodes (node_id, version, changeset_id, latitude, longitude, "timestamp", tile, visible)
+    SELECT n, 1, 1 + n % 2, n * 100, n * 200, '2020-02-20T20:20:20Z', 0, true
+        FROM generate_series(1, 20000) AS n;
+
+INSERT INTO node_tags (node_id, version, k, v)
+    SELECT n, 1, 'name', 'Node ' || n
+        FROM generate_series(1, 20000) AS n;
+
+-- Modified and deleted nodes
+INSERT INTO nodes (node_id, version, changeset_id, latitude, longitude, "timestamp", tile, visible)
+    SELECT n, v, v, n * 100, n * 200, '2020-02-20T20:20:22Z', 0, v = 1 OR n % 2 = 0
+        FROM generate_series(20001, 20020) AS n, generate_series(1, 2) AS v;
+
+INSERT INTO ways (way_id, version, changeset_id, "timestamp", visible)
+    SELECT w, 1, 1, '2020-02-20T20:20:20Z', true
+        FROM generate_series(1, 3000) AS w;
+
+INSERT INTO way_nodes (way_id, version, sequence_id, node_id)
+    SELECT w, 1, s, w + s
+        FROM generate_series(1, 3000) AS w, generate_series(0, 2) AS s;
+
+INSERT INTO way_tags (way_id, version, k, v)
+    SELECT w, 1, 'highway', 'residential'
+        FROM generate_series(1, 3000) AS w;
+
+INSERT INTO ways (way_id, version, changeset_id, "timestamp", visible)
+    SELECT w, 2, 2, '2020-02-20T20:20:22Z', w % 2 = 0
+        FROM generate_series(2991, 3000) AS w;
+
+INSERT INTO relations (relation_id, version, changeset_id, "timestamp", visible)
+    SELECT r, 1, 2, '2020-02-20T20:20:22Z', true
+        FROM generate_series(1, 10) AS r;
+
+INSERT INTO relation_members (relation_id, version, sequence_id, member_type, member_id, member_role)
+    SELECT r, 1, s, 'Way', r * 10 + s, 'outer'
+        FROM generate_series(1, 10) AS r, generate_series(1, 3) AS s;
+
+INSERT INTO relation_tags (relation_id, version, k, v)
+    SELECT r, 1, 'type', 'multipolygon'
+        FROM generate_series(1, 10) AS r;
+
+COMMIT;
@@ -0,0 +1,178 @@
+#pragma once
+
+// Helpers for creating pgoutput messages in tests
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class message
+{
+public:
+    explicit message(char op) { m_data += op; }
+
+    template <typename T>
+    message &add(T value)
+    {
+        for (unsigned int i = 0; i < sizeof(T); ++i) {
+            m_data += static_cast<char>(
+                (static_cast<uint64_t>(value) >> (8U * (sizeof(T) - i - 1))) &
+                0xffU);
+        }
+        return *this;
+    }
+
+    message &add_string(std::string const &str)
+    {
+        m_data += str;
+        m_data += '\0';
+        return *this;
+    }
+
+    message &add_text_column(std::string const &str)
+    {
+        m_data += 't';
+        add<int32_t>(static_cast<int32_t>(str.size()));
+        m_data += str;
+        return *this;
+    }
+
+    template <typename T>
+    message &add_binary_column(T value)
+    {
+        m_data += 'b';
+        add<int32_t>(sizeof(T));
+        return add<T>(value);
+    }
+
+    message &add_null_column()
+    {
+        m_data += 'n';
+        return *this;
+    }
+
+    [[nodiscard]] std::string const &data() const noexcept { return m_data; }
+
+private:
+    std::string m_data;
+};
+
+inline std::string relation_message(int32_t relation_id,
+                                    std::string const &name,
+                                    std::vector<std::string> const &columns)
+{
+    message msg{'R'};
+    msg.add<int32_t>(relation_id)
+        .add_string("public")
+        .add_string(name)
+        .add<int8_t>('d')
+        .add<int16_t>(static_cast<int16_t>(columns.size()));
+    for (auto const &column : columns) {
+        msg.add<int8_t>(0).add_string(column).add<int32_t>(20).add<int32_t>(
+            -1);
+    }
+    return msg.data();
+}
+
+inline std::string relation_message(int32_t relation_id,
+                                    std::string const &name,
+                                    std::string const &id_column)
+{
+    return relation_message(relation_id, name,
+                            {id_column, "latitude", "longitude",
+                             "changeset_id", "visible", "timestamp", "tile",
+                             "version", "redaction_id"});
+}
+
+inline message &add_tuple(message &msg, std::string const &id,
+                          std::string const &changeset,
+                          std::string const &version,
+                          char const *redaction = nullptr)
+{
+    msg.add<int16_t>(9)
+        .add_text_column(id)
+        .add_text_column("1")
+        .add_text_column("2")
+        .add_text_column(changeset)
+        .add_text_column("t")
+        .add_text_column("2020-01-01 00:00:00")
+        .add_text_column("1234")
+        .add_text_column(version);
+    if (redaction) {
+        msg.add_text_column(redaction);
+    } else {
+        msg.add_null_column();
+    }
+    return msg;
+}
+
+inline std::string begin_message(uint32_t xid)
+{
+    return message{'B'}
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .add<uint32_t>(xid)
+        .data();
+}
+
+inline std::string commit_message()
+{
+    return message{'C'}
+        .add<int8_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .data();
+}
+
+inline std::string insert_message(int32_t relation_id,
+                                  std::string const &id,
+                                  std::string const &changeset,
+                                  std::string const &version)
+{
+    message msg{'I'};
+    msg.add<int32_t>(relation_id).add<int8_t>('N');
+    return add_tuple(msg, id, changeset, version).data();
+}
+
+inline std::string update_message(int32_t relation_id,
+                                  std::string const &id,
+                                  std::string const &changeset,
+                                  std::string const &version,
+                                  char const *redaction)
+{
+    message msg{'U'};
+    msg.add<int32_t>(relation_id).add<int8_t>('N');
+    return add_tuple(msg, id, changeset, version, redaction).data();
+}
+
+inline std::string stream_start_message(uint32_t xid)
+{
+    return message{'S'}.add<uint32_t>(xid).add<int8_t>(1).data();
+}
+
+inline std::string stream_stop_message() { return message{'E'}.data(); }
+
+inline std::string stream_commit_message(uint32_t xid)
+{
+    return message{'c'}
+        .add<uint32_t>(xid)
+        .add<int8_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .add<int64_t>(0)
+        .data();
+}
+
+inline std::string stream_abort_message(uint32_t xid, uint32_t subxid)
+{
+    return message{'A'}.add<uint32_t>(xid).add<uint32_t>(subxid).data();
+}
+
+// Changes in streamed transactions have the xid in front
+inline std::string streamed(uint32_t xid, std::string const &msg)
+{
+    message result{msg[0]};
+    result.add<uint32_t>(xid);
+    return result.data() + msg.substr(1);
+}
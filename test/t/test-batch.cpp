@@ -0,0 +1,70 @@
+#include <catch.hpp>
+
+#include "batch.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+using seconds = batch_sizer::seconds;
+
+constexpr std::size_t const mbyte = 1024UL * 1024UL;
+
+} // anonymous namespace
+
+TEST_CASE("First batch has the initial size")
+{
+    batch_sizer const sizer{seconds{10}, 1024 * mbyte, 50000};
+    REQUIRE(sizer.next(seconds{60}) == 50000);
+    REQUIRE(sizer.rate() == 0.0);
+
+    batch_sizer const small{seconds{10}, 1024 * mbyte, 10};
+    REQUIRE(small.next(seconds{60}) == batch_sizer::min_changes);
+}
+
+TEST_CASE("Batch size follows the measured rate")
+{
+    batch_sizer sizer{seconds{10}, 1024 * mbyte, 10000};
+
+    // 10000 changes in one second: the next batch can be larger, but not
+    // more than max_growth times
+    sizer.update(10000, 10000 * 40, seconds{1});
+    REQUIRE(sizer.rate() == Approx(10000.0));
+    REQUIRE(sizer.bytes_per_change() == Approx(40.0));
+    REQUIRE(sizer.next(seconds{60}) == 10000 * batch_sizer::max_growth);
+
+    sizer.update(40000, 40000 * 40, seconds{4});
+    REQUIRE(sizer.next(seconds{60}) == 100000);
+
+    // Slower batch: the rate is averaged
+    sizer.update(100000, 100000 * 40, seconds{20});
+    REQUIRE(sizer.rate() == Approx(7500.0));
+    REQUIRE(sizer.next(seconds{60}) == 75000);
+}
+
+TEST_CASE("Batch size is limited by remaining time")
+{
+    batch_sizer sizer{seconds{10}, 1024 * mbyte, 10000};
+    sizer.update(10000, 10000 * 40, seconds{1});
+
+    REQUIRE(sizer.next(seconds{2}) == 20000);
+    REQUIRE(sizer.next(seconds{0}) == batch_sizer::min_changes);
+}
+
+TEST_CASE("Batch size is limited by memory budget")
+{
+    batch_sizer sizer{seconds{10}, 1 * mbyte, 10000};
+    sizer.update(10000, 10000 * 100, seconds{0.1});
+
+    REQUIRE(sizer.next(seconds{60}) == mbyte / 100);
+}
+
+TEST_CASE("Empty batches are ignored")
+{
+    batch_sizer sizer{seconds{10}, 1024 * mbyte, 10000};
+    sizer.update(0, 0, seconds{1});
+    REQUIRE(sizer.rate() == 0.0);
+    REQUIRE(sizer.next(seconds{60}) == 10000);
+}
@@ -0,0 +1,158 @@
+#include <catch.hpp>
+
+#include "binlog.hpp"
+#include "osmobj.hpp"
+
+#include <osmium/osm/item_type.hpp>
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+std::string const text_log{"1A/B374D848 502 N n10 v1 c1\n"
+                           "1A/B374D850 502 N w20 v2 c1\n"
+                           "1A/B374D858 502 C\n"
+                           "1A/B374D860 503 R r30 v3 c2 NULL\n"
+                           "1A/B374D868 503 R n11 v2 c2 7\n"
+                           "1A/B374D870 503 C\n"};
+
+void write_file(std::string const &file_name, std::string const &data)
+{
+    std::ofstream file{file_name, std::ios::binary};
+    file << data;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Binary log file names")
+{
+    REQUIRE(blog::is_binary_log_name("osm-repl-x-lsn-1A-B374D848.blog"));
+    REQUIRE(blog::is_binary_log_name("osm-repl-x-lsn-1A-B374D848.blog.done"));
+    REQUIRE_FALSE(blog::is_binary_log_name("osm-repl-x-lsn-1A-B374D848.log"));
+    REQUIRE_FALSE(
+        blog::is_binary_log_name("osm-repl-x-lsn-1A-B374D848.log.done"));
+    REQUIRE_FALSE(blog::is_binary_log_name(".blog"));
+}
+
+TEST_CASE("Convert text log to records and back")
+{
+    auto const records = blog::text_to_records(text_log);
+    REQUIRE(records.size() == 6 * sizeof(blog::record));
+
+    blog::record rec{};
+    records.copy(reinterpret_cast<char *>(&rec), sizeof(rec),
+                 3 * sizeof(blog::record));
+    REQUIRE(rec.lsn == 0x1AB374D860ULL);
+    REQUIRE(rec.xid == 503);
+    REQUIRE(rec.op == 'R');
+    REQUIRE(rec.type == 'r');
+    REQUIRE(rec.id == 30);
+    REQUIRE(rec.version == 3);
+    REQUIRE(rec.changeset == 2);
+    REQUIRE(rec.redaction == blog::no_redaction);
+
+    std::string text;
+    for (std::size_t i = 0; i < records.size(); i += sizeof(blog::record)) {
+        records.copy(reinterpret_cast<char *>(&rec), sizeof(rec), i);
+        blog::append_text(&text, rec);
+    }
+    REQUIRE(text == text_log);
+}
+
+TEST_CASE("Lines in wrong format are not converted")
+{
+    REQUIRE_THROWS_AS(blog::text_to_records("1/3 5 N x10 v1 c1\n"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(blog::text_to_records("1/4 5 N n10 v1\n"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(blog::text_to_records("1/5 five C\n"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(blog::text_to_records("1/6 5 R n10 v1 c1 -3\n"),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(blog::text_to_records("1/7 5 C\n\n"),
+                      std::runtime_error);
+}
+
+TEST_CASE("Error lines and redaction id 0 are converted")
+{
+    auto const records = blog::text_to_records("1/2 5 X something went wrong\n"
+                                               "1/3 5 R n10 v1 c1 0\n"
+                                               "1/4 5 N n10 v1 c1");
+    REQUIRE(records.size() == 3 * sizeof(blog::record));
+
+    blog::record rec{};
+    records.copy(reinterpret_cast<char *>(&rec), sizeof(rec), 0);
+    REQUIRE(rec.lsn == 0x100000002ULL);
+    REQUIRE(rec.xid == 5);
+    REQUIRE(rec.op == 'X');
+
+    records.copy(reinterpret_cast<char *>(&rec), sizeof(rec),
+                 sizeof(blog::record));
+    REQUIRE(rec.op == 'R');
+    REQUIRE(rec.redaction == 0);
+
+    std::string text;
+    blog::append_text(&text, rec);
+    REQUIRE(text == "1/3 5 R n10 v1 c1 0\n");
+}
+
+TEST_CASE("Read binary log file")
+{
+    std::string const file_name{"test-log.blog"};
+    write_file(TEST_DIR "/" + file_name,
+               blog::file_data(blog::text_to_records(text_log)));
+
+    blog::mapped_file const file{TEST_DIR "/" + file_name};
+    REQUIRE(file.size() == 6);
+    REQUIRE(file.get(1).type == 'w');
+    REQUIRE(file.get(1).id == 20);
+    REQUIRE(file.get(2).op == 'C');
+
+    changeset_user_lookup cucache;
+    osmobjects objects;
+    read_log(objects, TEST_DIR "/", file_name, &cucache);
+
+    REQUIRE(objects.size() == 2);
+    REQUIRE(objects.nodes().size() == 1);
+    REQUIRE(objects.nodes()[0].id() == 10);
+    REQUIRE(objects.ways().size() == 1);
+    REQUIRE(objects.ways()[0].version() == 2);
+    REQUIRE(cucache.size() == 1);
+}
+
+TEST_CASE("Read empty binary log file")
+{
+    std::string const file_name{TEST_DIR "/test-empty.blog"};
+    write_file(file_name, blog::file_data({}));
+
+    blog::mapped_file const file{file_name};
+    REQUIRE(file.size() == 0);
+}
+
+TEST_CASE("Damaged binary log files are detected")
+{
+    std::string const file_name{TEST_DIR "/test-damaged.blog"};
+    auto data = blog::file_data(blog::text_to_records(text_log));
+
+    SECTION("wrong checksum")
+    {
+        data[sizeof(blog::header) + 10] ^= 1;
+        write_file(file_name, data);
+        REQUIRE_THROWS_AS(blog::mapped_file{file_name}, std::runtime_error);
+    }
+
+    SECTION("truncated")
+    {
+        data.resize(data.size() - sizeof(blog::record));
+        write_file(file_name, data);
+        REQUIRE_THROWS_AS(blog::mapped_file{file_name}, std::runtime_error);
+    }
+
+    SECTION("text log")
+    {
+        write_file(file_name, text_log);
+        REQUIRE_THROWS_AS(blog::mapped_file{file_name}, std::runtime_error);
+    }
+}
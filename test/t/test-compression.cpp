@@ -0,0 +1,149 @@
+#include <catch.hpp>
+
+#include "compression.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+void write_file(std::string const &file_name, std::string const &data)
+{
+    std::ofstream file{file_name, std::ios::binary};
+    file << data;
+}
+
+std::vector<std::string> read_lines(std::string const &file_name)
+{
+    line_reader reader{file_name};
+    std::vector<std::string> lines;
+    for (std::string line; reader.getline(&line);) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Enough lines to need several reads and compressed output pieces
+std::vector<std::string> test_lines()
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 100000; ++i) {
+        lines.push_back("0/" + std::to_string(i) + " 502 N n" +
+                        std::to_string(i * 7919 % 100003) + " v1 c1");
+    }
+    return lines;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Compression type from file name")
+{
+    REQUIRE(compression_of_file("x.log") == compression_type::none);
+    REQUIRE(compression_of_file("x.log.done") == compression_type::none);
+    REQUIRE(compression_of_file("x.log.gz") == compression_type::gzip);
+    REQUIRE(compression_of_file("x.log.gz.done") == compression_type::gzip);
+    REQUIRE(compression_of_file("x.log.zst") == compression_type::zstd);
+    REQUIRE(compression_of_file("x.log.zst.done") == compression_type::zstd);
+
+    REQUIRE(std::string{compression_suffix(compression_type::none)}.empty());
+    REQUIRE(std::string{compression_suffix(compression_type::gzip)} == ".gz");
+    REQUIRE(std::string{compression_suffix(compression_type::zstd)} == ".zst");
+}
+
+TEST_CASE("Write and read compressed log files")
+{
+    auto const type = GENERATE(compression_type::none, compression_type::gzip,
+                               compression_type::zstd);
+    if (!compression_available(type)) {
+        return;
+    }
+
+    std::string const file_name =
+        std::string{TEST_DIR "/test-compression.log"} +
+        compression_suffix(type);
+    auto const lines = test_lines();
+
+    // Compress in pieces of different sizes
+    compressor comp{type};
+    std::string data;
+    std::string piece;
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        piece += lines[i];
+        piece += '\n';
+        if (i % 997 == 0) {
+            data += comp.compress(piece);
+            piece.clear();
+        }
+    }
+    data += comp.compress(piece);
+    data += comp.finish();
+    write_file(file_name, data);
+
+    if (type != compression_type::none) {
+        REQUIRE(data.size() < lines.size() * 10);
+    }
+
+    REQUIRE(read_lines(file_name) == lines);
+}
+
+TEST_CASE("Read concatenated gzip streams")
+{
+    std::string const file_name{TEST_DIR "/test-concat.log.gz"};
+
+    std::string data;
+    for (char const *const text : {"a\nb", "\nc\n"}) {
+        compressor comp{compression_type::gzip};
+        data += comp.compress(text);
+        data += comp.finish();
+    }
+    write_file(file_name, data);
+
+    REQUIRE(read_lines(file_name) == std::vector<std::string>{"a", "b", "c"});
+}
+
+TEST_CASE("Read empty log files")
+{
+    write_file(TEST_DIR "/test-empty.log", "");
+    REQUIRE(read_lines(TEST_DIR "/test-empty.log").empty());
+
+    compressor comp{compression_type::gzip};
+    write_file(TEST_DIR "/test-empty.log.gz", comp.finish());
+    REQUIRE(read_lines(TEST_DIR "/test-empty.log.gz").empty());
+}
+
+TEST_CASE("Last line without newline")
+{
+    write_file(TEST_DIR "/test-no-newline.log", "a\nb");
+    REQUIRE(read_lines(TEST_DIR "/test-no-newline.log") ==
+            std::vector<std::string>{"a", "b"});
+}
+
+TEST_CASE("Truncated gzip log file")
+{
+    std::string const file_name{TEST_DIR "/test-truncated.log.gz"};
+
+    compressor comp{compression_type::gzip};
+    auto data = comp.compress("0/1 502 N n1 v1 c1\n0/2 502 C\n");
+    data += comp.finish();
+    data.resize(data.size() - 4);
+    write_file(file_name, data);
+
+    REQUIRE_THROWS_AS(read_lines(file_name), std::runtime_error);
+}
+
+TEST_CASE("Text log file with gz suffix")
+{
+    std::string const file_name{TEST_DIR "/test-not-compressed.log.gz"};
+    write_file(file_name, "0/1 502 N n1 v1 c1\n");
+
+    REQUIRE_THROWS_AS(read_lines(file_name), std::runtime_error);
+}
+
+TEST_CASE("Missing log file")
+{
+    REQUIRE_THROWS_AS(read_lines(TEST_DIR "/does-not-exist.log.gz"),
+                      std::system_error);
+}
@@ -0,0 +1,102 @@
+#include <catch.hpp>
+
+#include "cscache.hpp"
+#include "cslookup.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("Missing changeset cache file gives empty cache")
+{
+    changeset_cache const cache{TEST_DIR "/does-not-exist.cscache"};
+    REQUIRE(cache.size() == 0);
+
+    userinfo user;
+    REQUIRE_FALSE(cache.find(1, &user));
+}
+
+TEST_CASE("Write and read changeset cache")
+{
+    std::string const file_name{TEST_DIR "/test.cscache"};
+
+    changeset_user_lookup lookup;
+    lookup.set_user(17, 3, "testuser3");
+    lookup.set_user(5, 1, "testuser1");
+    lookup.set_user(6, 1, "testuser1");
+    lookup.set_user(100, 2, "Benutzer \xc3\xa4");
+    lookup.add(8); // user unknown, not written
+    changeset_cache::write(file_name, lookup);
+
+    changeset_cache const cache{file_name};
+    REQUIRE(cache.size() == 4);
+
+    userinfo user;
+    REQUIRE(cache.find(5, &user));
+    REQUIRE(user.id == 1);
+    REQUIRE(user.username == "testuser1");
+
+    REQUIRE(cache.find(6, &user));
+    REQUIRE(user.id == 1);
+    REQUIRE(user.username == "testuser1");
+
+    REQUIRE(cache.find(100, &user));
+    REQUIRE(user.id == 2);
+    REQUIRE(user.username == "Benutzer \xc3\xa4");
+
+    REQUIRE(cache.find(17, &user));
+    REQUIRE(user.id == 3);
+    REQUIRE(user.username == "testuser3");
+
+    REQUIRE_FALSE(cache.find(8, &user));
+    REQUIRE_FALSE(cache.find(1, &user));
+    REQUIRE_FALSE(cache.find(1000, &user));
+
+    // Writing again replaces the old file
+    changeset_user_lookup new_lookup;
+    new_lookup.set_user(6, 4, "x");
+    changeset_cache::write(file_name, new_lookup);
+
+    changeset_cache const new_cache{file_name};
+    REQUIRE(new_cache.size() == 1);
+    REQUIRE(new_cache.find(6, &user));
+    REQUIRE_FALSE(new_cache.find(5, &user));
+}
+
+TEST_CASE("Damaged changeset cache files are detected")
+{
+    std::string const file_name{TEST_DIR "/test-damaged.cscache"};
+
+    changeset_user_lookup lookup;
+    lookup.set_user(1, 1, "testuser1");
+    changeset_cache::write(file_name, lookup);
+
+    std::string data;
+    {
+        std::ifstream in{file_name, std::ios::binary};
+        data.assign(std::istreambuf_iterator<char>{in},
+                    std::istreambuf_iterator<char>{});
+    }
+
+    SECTION("truncated")
+    {
+        data.resize(data.size() - 2);
+    }
+
+    SECTION("wrong magic")
+    {
+        data[0] = 'X';
+    }
+
+    SECTION("too short")
+    {
+        data.resize(10);
+    }
+
+    {
+        std::ofstream out{file_name, std::ios::binary | std::ios::trunc};
+        out << data;
+    }
+
+    REQUIRE_THROWS_AS(changeset_cache{file_name}, std::runtime_error);
+}
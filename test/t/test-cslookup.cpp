@@ -0,0 +1,115 @@
+#include <catch.hpp>
+
+#include "cslookup.hpp"
+
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+TEST_CASE("Empty changeset user lookup")
+{
+    changeset_user_lookup const lookup;
+    REQUIRE(lookup.empty());
+    REQUIRE(lookup.size() == 0);
+    REQUIRE_FALSE(lookup.contains(1));
+    REQUIRE_THROWS_AS(lookup.get(1), std::out_of_range);
+}
+
+TEST_CASE("Changesets with unknown and known users")
+{
+    changeset_user_lookup lookup;
+    lookup.add(17);
+    lookup.add(17);
+    lookup.set_user(5, 1, "testuser1");
+    lookup.set_user(6, 1, "testuser1");
+
+    REQUIRE(lookup.size() == 3);
+    REQUIRE(lookup.contains(17));
+    REQUIRE(lookup.contains(5));
+    REQUIRE_FALSE(lookup.contains(7));
+
+    auto const unknown = lookup.get(17);
+    REQUIRE(unknown.id == 0);
+    REQUIRE(unknown.name.empty());
+
+    auto const user = lookup.get(6);
+    REQUIRE(user.id == 1);
+    REQUIRE(user.name == "testuser1");
+
+    // Adding again doesn't change the user
+    lookup.add(5);
+    REQUIRE(lookup.get(5).name == "testuser1");
+
+    lookup.set_user(17, 2, "testuser2");
+    REQUIRE(lookup.size() == 3);
+    REQUIRE(lookup.get(17).id == 2);
+    REQUIRE(lookup.get(17).name == "testuser2");
+
+    REQUIRE_THROWS_AS(lookup.get(7), std::out_of_range);
+}
+
+TEST_CASE("Changed user name applies to all changesets of the user")
+{
+    changeset_user_lookup lookup;
+    lookup.set_user(5, 1, "old name");
+    lookup.set_user(6, 1, "old name");
+    lookup.set_user(6, 1, "new name");
+
+    REQUIRE(lookup.get(5).name == "new name");
+    REQUIRE(lookup.get(6).name == "new name");
+
+    lookup.set_user(6, 0, {});
+    REQUIRE(lookup.get(6).id == 0);
+    REQUIRE(lookup.get(5).id == 1);
+}
+
+TEST_CASE("Changeset id 0")
+{
+    changeset_user_lookup lookup;
+    REQUIRE_FALSE(lookup.contains(0));
+    lookup.add(0);
+    REQUIRE(lookup.contains(0));
+    REQUIRE(lookup.size() == 1);
+    REQUIRE(lookup.get(0).id == 0);
+
+    lookup.set_user(0, 3, "testuser3");
+    REQUIRE(lookup.size() == 1);
+    REQUIRE(lookup.get(0).name == "testuser3");
+}
+
+TEST_CASE("Many changesets")
+{
+    changeset_user_lookup lookup;
+    for (osmium::changeset_id_type cid = 1; cid <= 100000; ++cid) {
+        if (cid % 3 == 0) {
+            lookup.add(cid);
+        } else {
+            auto const uid = cid % 100 + 1;
+            lookup.set_user(cid, uid, "user" + std::to_string(uid));
+        }
+    }
+
+    REQUIRE(lookup.size() == 100000);
+
+    std::map<osmium::changeset_id_type, osmium::user_id_type> seen;
+    std::size_t wrong_names = 0;
+    lookup.for_each([&](osmium::changeset_id_type cid,
+                        changeset_user_lookup::user const &user) {
+        seen[cid] = user.id;
+        if (user.id != 0 && user.name != "user" + std::to_string(user.id)) {
+            ++wrong_names;
+        }
+    });
+    REQUIRE(seen.size() == 100000);
+    REQUIRE(wrong_names == 0);
+    REQUIRE(seen.begin()->first == 1);
+    REQUIRE(seen.rbegin()->first == 100000);
+
+    REQUIRE(lookup.get(99999).id == 0);
+    REQUIRE(lookup.get(100000).id == 1);
+    REQUIRE(lookup.get(100000).name == "user1");
+    REQUIRE_FALSE(lookup.contains(100001));
+}
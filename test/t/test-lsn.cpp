@@ -3,6 +3,9 @@
 
 #include "lsn.hpp"
 
+#include <array>
+#include <string_view>
+
 TEST_CASE("Valid LSN")
 {
     lsn_type const l1;
@@ -29,6 +32,10 @@ TEST_CASE("Valid LSN")
     REQUIRE(l4.lower() == 0x55667788ULL);
     REQUIRE(l4.str() == "11223344/55667788");
 
+    lsn_type const l5{(0x11223344ULL << 32U) + 0x55667788ULL};
+    REQUIRE(l5 == l4);
+    REQUIRE(l5.str() == "11223344/55667788");
+
     REQUIRE(l1 < l2);
     REQUIRE(l1 < l3);
     REQUIRE(l3 < l2);
@@ -39,10 +46,27 @@ TEST_CASE("Valid LSN")
     REQUIRE_FALSE(l3 > l4);
 }
 
+TEST_CASE("Format LSN without allocating")
+{
+    std::array<char, lsn_type::format_buffer_size> buffer{};
+
+    REQUIRE(lsn_type{"0/deadbeef"}.format(buffer.data()) == "0/DEADBEEF");
+    REQUIRE(lsn_type{~0ULL}.format(buffer.data()) == "FFFFFFFF/FFFFFFFF");
+}
+
 TEST_CASE("Invalid LSN")
 {
     REQUIRE_THROWS(lsn_type{"foo"});
     REQUIRE_THROWS(lsn_type{"12.34"});
     REQUIRE_THROWS(lsn_type{"some/thing"});
     REQUIRE_THROWS(lsn_type{"123-3x"});
+    REQUIRE_THROWS(lsn_type{"/12"});
+    REQUIRE_THROWS(lsn_type{"12/"});
+}
+
+TEST_CASE("LSN from part of a string")
+{
+    std::string_view const text{"1A/B374D848 502 C"};
+    REQUIRE(lsn_type{text.substr(0, 11)}.str() == "1A/B374D848");
+    REQUIRE_THROWS(lsn_type{text.substr(0, 12)});
 }
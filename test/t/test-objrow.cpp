@@ -0,0 +1,30 @@
+#include <catch.hpp>
+
+#include "exception.hpp"
+#include "objrow.hpp"
+
+#include <osmium/osm/types.hpp>
+
+#include <cstdint>
+#include <limits>
+
+TEST_CASE("Parse numbers from query results")
+{
+    REQUIRE(parse_number<osmium::object_id_type>("0") == 0);
+    REQUIRE(parse_number<osmium::object_id_type>("1234567890123") ==
+            1234567890123);
+    REQUIRE(parse_number<int64_t>("-1800000000") == -1800000000);
+    REQUIRE(parse_number<osmium::object_version_type>("17") == 17);
+    REQUIRE(parse_number<uint32_t>("4294967295") ==
+            std::numeric_limits<uint32_t>::max());
+}
+
+TEST_CASE("Parsing invalid numbers fails")
+{
+    REQUIRE_THROWS_AS(parse_number<int64_t>(""), database_error);
+    REQUIRE_THROWS_AS(parse_number<int64_t>("abc"), database_error);
+    REQUIRE_THROWS_AS(parse_number<int64_t>("12a"), database_error);
+    REQUIRE_THROWS_AS(parse_number<int64_t>("1.5"), database_error);
+    REQUIRE_THROWS_AS(parse_number<uint32_t>("-1"), database_error);
+    REQUIRE_THROWS_AS(parse_number<uint32_t>("4294967296"), database_error);
+}
@@ -0,0 +1,156 @@
+#include <catch.hpp>
+
+#include "pgarray.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+void add_int32(std::string *data, std::int64_t value)
+{
+    auto const v = static_cast<std::uint32_t>(value);
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        *data += static_cast<char>((v >> static_cast<unsigned>(shift)) & 0xffU);
+    }
+}
+
+// How PostgreSQL sends a one-dimensional array in binary format
+std::string binary_array(std::vector<std::string> const &elements,
+                         std::uint32_t type = pg_binary_array::text_oid)
+{
+    std::string data;
+    add_int32(&data, elements.empty() ? 0 : 1); // dimensions
+    add_int32(&data, 0);                        // has NULL elements
+    add_int32(&data, type);
+    if (!elements.empty()) {
+        add_int32(&data, static_cast<std::int64_t>(elements.size()));
+        add_int32(&data, 1); // lower bound
+    }
+    for (auto const &element : elements) {
+        add_int32(&data, static_cast<std::int64_t>(element.size()));
+        data += element;
+    }
+    return data;
+}
+
+std::string int8(std::uint64_t value)
+{
+    std::string data;
+    add_int32(&data, static_cast<std::int64_t>(value >> 32U));
+    add_int32(&data, static_cast<std::int64_t>(value & 0xffffffffU));
+    return data;
+}
+
+std::vector<std::string> read(std::string_view data)
+{
+    pg_binary_array array{data, pg_binary_array::text_oid};
+    std::vector<std::string> elements;
+    std::string_view element;
+    while (array.next(&element)) {
+        elements.emplace_back(element);
+    }
+    REQUIRE(elements.size() == array.size());
+    return elements;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Empty array")
+{
+    REQUIRE(read(binary_array({})).empty());
+}
+
+TEST_CASE("Array with strings")
+{
+    std::vector<std::string> const elements{
+        "", "abc", "a,b", "{\"x\"}", "NULL", "a\\b", std::string{"a\0b", 3}};
+    REQUIRE(read(binary_array(elements)) == elements);
+}
+
+TEST_CASE("Array with UTF-8 strings")
+{
+    std::vector<std::string> const elements{"Straße", "東京 駅"};
+    REQUIRE(read(binary_array(elements)) == elements);
+}
+
+TEST_CASE("Array with integers")
+{
+    auto const data =
+        binary_array({int8(1), int8(static_cast<std::uint64_t>(-22)),
+                      int8(9223372036854775807)},
+                     pg_binary_array::int8_oid);
+    pg_binary_array array{data, pg_binary_array::int8_oid};
+    REQUIRE(array.size() == 3);
+
+    std::int64_t value = 0;
+    REQUIRE(array.next(&value));
+    REQUIRE(value == 1);
+    REQUIRE(array.next(&value));
+    REQUIRE(value == -22);
+    REQUIRE(array.next(&value));
+    REQUIRE(value == 9223372036854775807);
+    REQUIRE_FALSE(array.next(&value));
+}
+
+TEST_CASE("Array with integers of wrong size")
+{
+    auto const data = binary_array({"1234"}, pg_binary_array::int8_oid);
+    pg_binary_array array{data, pg_binary_array::int8_oid};
+    std::int64_t value = 0;
+    REQUIRE_THROWS_AS(array.next(&value), std::runtime_error);
+}
+
+TEST_CASE("Array with wrong element type")
+{
+    auto const data = binary_array({int8(1)}, pg_binary_array::int8_oid);
+    REQUIRE_THROWS_AS(pg_binary_array(data, pg_binary_array::text_oid),
+                      std::runtime_error);
+}
+
+TEST_CASE("Array with NULL elements")
+{
+    std::string data;
+    add_int32(&data, 1);
+    add_int32(&data, 1);
+    add_int32(&data, pg_binary_array::text_oid);
+    add_int32(&data, 1);
+    add_int32(&data, 1);
+    add_int32(&data, -1);
+    REQUIRE_THROWS_AS(read(data), std::runtime_error);
+
+    // Flag not set, but NULL element anyway
+    data[7] = '\0';
+    REQUIRE_THROWS_AS(read(data), std::runtime_error);
+}
+
+TEST_CASE("Array with two dimensions")
+{
+    std::string data;
+    add_int32(&data, 2);
+    add_int32(&data, 0);
+    add_int32(&data, pg_binary_array::text_oid);
+    for (int i = 0; i < 2; ++i) {
+        add_int32(&data, 1);
+        add_int32(&data, 1);
+    }
+    add_int32(&data, 1);
+    data += 'a';
+    REQUIRE_THROWS_AS(read(data), std::runtime_error);
+}
+
+TEST_CASE("Truncated arrays")
+{
+    auto const data = binary_array({"abc", "de"});
+    for (std::size_t len = 0; len < data.size(); ++len) {
+        REQUIRE_THROWS_AS(read(data.substr(0, len)), std::runtime_error);
+    }
+}
+
+TEST_CASE("Array with data after the last element")
+{
+    REQUIRE_THROWS_AS(read(binary_array({"abc"}) + "x"), std::runtime_error);
+}
@@ -0,0 +1,513 @@
+#include <catch.hpp>
+
+#include "binlog.hpp"
+#include "pgoutput-messages.hpp"
+#include "pgoutput.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+TEST_CASE("parse insert and update")
+{
+    pgoutput::parser parser;
+
+    // the parser doesn't copy the message, so keep it around
+    std::string msg = relation_message(16385, "nodes", "node_id");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    parser.parse_op_relation();
+
+    msg = insert_message(16385, "10", "3", "1");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'I');
+    std::string out;
+    parser.parse_op_insert(&out);
+    REQUIRE(out == "N n10 v1 c3");
+
+    msg = update_message(16385, "10", "3", "1", "7");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    out.clear();
+    parser.parse_op_update(&out);
+    REQUIRE(out == "R n10 v1 c3 7");
+
+    msg = update_message(16385, "10", "3", "1", nullptr);
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    out.clear();
+    parser.parse_op_update(&out);
+    REQUIRE(out == "R n10 v1 c3 NULL");
+}
+
+TEST_CASE("parse update with old tuple")
+{
+    pgoutput::parser parser;
+
+    std::string msg = relation_message(16385, "ways", "way_id");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    parser.parse_op_relation();
+
+    message update{'U'};
+    update.add<int32_t>(16385).add<int8_t>('O');
+    add_tuple(update, "20", "3", "1");
+    update.add<int8_t>('N');
+    add_tuple(update, "20", "3", "1", "5");
+
+    msg = update.data();
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    std::string out;
+    parser.parse_op_update(&out);
+    REQUIRE(out == "R w20 v1 c3 5");
+}
+
+TEST_CASE("parse insert and update with binary columns")
+{
+    pgoutput::parser parser;
+
+    std::string msg = relation_message(16385, "nodes", "node_id");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    parser.parse_op_relation();
+
+    message insert{'I'};
+    insert.add<int32_t>(16385).add<int8_t>('N').add<int16_t>(9);
+    insert.add_binary_column<int64_t>(12345678901)
+        .add_binary_column<int32_t>(1)
+        .add_binary_column<int32_t>(2)
+        .add_binary_column<int64_t>(300)
+        .add_text_column("t")
+        .add_binary_column<int64_t>(0)
+        .add_binary_column<int64_t>(1234)
+        .add_binary_column<int64_t>(2)
+        .add_null_column();
+
+    msg = insert.data();
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'I');
+    std::string out;
+    parser.parse_op_insert(&out);
+    REQUIRE(out == "N n12345678901 v2 c300");
+
+    message update{'U'};
+    update.add<int32_t>(16385).add<int8_t>('N').add<int16_t>(9);
+    update.add_binary_column<int64_t>(10)
+        .add_binary_column<int32_t>(1)
+        .add_binary_column<int32_t>(2)
+        .add_binary_column<int64_t>(3)
+        .add_text_column("f")
+        .add_binary_column<int64_t>(0)
+        .add_binary_column<int64_t>(1234)
+        .add_binary_column<int64_t>(1)
+        .add_binary_column<int32_t>(70000);
+
+    msg = update.data();
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    out.clear();
+    parser.parse_op_update(&out);
+    REQUIRE(out == "R n10 v1 c3 70000");
+
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    blog::record rec{};
+    parser.parse_op_update(&rec);
+    REQUIRE(rec.op == 'R');
+    REQUIRE(rec.type == 'n');
+    REQUIRE(rec.id == 10);
+    REQUIRE(rec.version == 1);
+    REQUIRE(rec.changeset == 3);
+    REQUIRE(rec.redaction == 70000);
+}
+
+TEST_CASE("relation metadata sent again replaces old metadata")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message("0/10", begin_message(500));
+    builder.add_message("0/11", relation_message(16385, "nodes", "node_id"));
+    builder.add_message("0/12", relation_message(16386, "ways", "way_id"));
+    builder.add_message("0/13", insert_message(16385, "10", "3", "1"));
+    builder.add_message("0/14", relation_message(16385, "relations",
+                                                 "relation_id"));
+    builder.add_message("0/15", insert_message(16385, "30", "3", "1"));
+    builder.add_message("0/16", insert_message(16386, "20", "3", "1"));
+    builder.add_message("0/17", commit_message());
+
+    REQUIRE(builder.committed_data() == "0/13 500 N n10 v1 c3\n"
+                                        "0/15 500 N r30 v1 c3\n"
+                                        "0/16 500 N w20 v1 c3\n"
+                                        "0/17 500 C\n");
+}
+
+TEST_CASE("parse insert and update with publication column list")
+{
+    pgoutput::parser parser;
+
+    std::string msg = relation_message(
+        16386, "ways", {"way_id", "version", "changeset_id", "redaction_id"});
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    parser.parse_op_relation();
+
+    message insert{'I'};
+    insert.add<int32_t>(16386).add<int8_t>('N').add<int16_t>(4);
+    insert.add_text_column("20")
+        .add_text_column("1")
+        .add_text_column("3")
+        .add_null_column();
+
+    msg = insert.data();
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'I');
+    std::string out;
+    parser.parse_op_insert(&out);
+    REQUIRE(out == "N w20 v1 c3");
+
+    message update{'U'};
+    update.add<int32_t>(16386).add<int8_t>('N').add<int16_t>(4);
+    update.add_text_column("20")
+        .add_text_column("1")
+        .add_text_column("3")
+        .add_text_column("8");
+
+    msg = update.data();
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'U');
+    out.clear();
+    parser.parse_op_update(&out);
+    REQUIRE(out == "R w20 v1 c3 8");
+}
+
+TEST_CASE("parse relation metadata with missing column")
+{
+    pgoutput::parser parser;
+
+    std::string const msg =
+        relation_message(16386, "ways", {"way_id", "version", "changeset_id"});
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    REQUIRE_THROWS(parser.parse_op_relation());
+}
+
+TEST_CASE("parse insert without relation metadata")
+{
+    pgoutput::parser parser;
+
+    std::string const msg = insert_message(16385, "10", "3", "1");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'I');
+    std::string out;
+    REQUIRE_THROWS(parser.parse_op_insert(&out));
+}
+
+TEST_CASE("parse truncated messages")
+{
+    pgoutput::parser parser;
+
+    std::string msg = relation_message(16385, "nodes", "node_id");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    parser.parse_op_relation();
+
+    std::string const insert = insert_message(16385, "10", "3", "1");
+    std::string const update = update_message(16385, "10", "3", "1", "7");
+
+    // Cut off anywhere, also in the middle of an integer
+    for (std::size_t len = 1; len < insert.size(); ++len) {
+        msg = insert.substr(0, len);
+        parser.set_row(msg);
+        REQUIRE(parser.parse_op() == 'I');
+        std::string out;
+        REQUIRE_THROWS(parser.parse_op_insert(&out));
+    }
+
+    for (std::size_t len = 1; len < update.size(); ++len) {
+        msg = update.substr(0, len);
+        parser.set_row(msg);
+        REQUIRE(parser.parse_op() == 'U');
+        std::string out;
+        REQUIRE_THROWS(parser.parse_op_update(&out));
+    }
+
+    std::string const relation = relation_message(16386, "ways", "way_id");
+    for (std::size_t len = 1; len < relation.size(); ++len) {
+        msg = relation.substr(0, len);
+        parser.set_row(msg);
+        REQUIRE(parser.parse_op() == 'R');
+        REQUIRE_THROWS(parser.parse_op_relation());
+    }
+
+    msg.clear();
+    parser.set_row(msg);
+    REQUIRE_THROWS(parser.parse_op());
+}
+
+TEST_CASE("parse unknown relation")
+{
+    pgoutput::parser parser;
+
+    std::string const msg = relation_message(16385, "users", "user_id");
+    parser.set_row(msg);
+    REQUIRE(parser.parse_op() == 'R');
+    REQUIRE_THROWS(parser.parse_op_relation());
+}
+
+TEST_CASE("log builder")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message("0/10", begin_message(500));
+    builder.add_message("0/11", relation_message(16385, "nodes", "node_id"));
+    builder.add_message("0/12", relation_message(16386, "ways", "way_id"));
+    builder.add_message("0/13", insert_message(16385, "10", "3", "1"));
+    builder.add_message("0/14", insert_message(16386, "20", "3", "1"));
+    builder.add_message("0/15", commit_message());
+
+    // empty transaction doesn't create any log lines
+    builder.add_message("0/20", begin_message(501));
+    builder.add_message("0/21", commit_message());
+
+    // transaction still in progress
+    builder.add_message("0/30", begin_message(502));
+    builder.add_message("0/31", insert_message(16385, "11", "4", "1"));
+
+    REQUIRE(builder.has_commits());
+    REQUIRE(builder.has_actual_data());
+    REQUIRE(builder.lsn() == "0/21");
+    REQUIRE(builder.committed_data() == "0/13 500 N n10 v1 c3\n"
+                                        "0/14 500 N w20 v1 c3\n"
+                                        "0/15 500 C\n");
+
+    builder.clear_committed();
+    REQUIRE_FALSE(builder.has_commits());
+    REQUIRE_FALSE(builder.has_actual_data());
+    REQUIRE(builder.committed_data().empty());
+
+    builder.add_message("0/32", commit_message());
+    REQUIRE(builder.has_commits());
+    REQUIRE(builder.has_actual_data());
+    REQUIRE(builder.lsn() == "0/32");
+    REQUIRE(builder.committed_data() == "0/31 502 N n11 v1 c4\n"
+                                        "0/32 502 C\n");
+}
+
+TEST_CASE("log builder with numeric LSNs")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message(lsn_type{0x10}, begin_message(500));
+    builder.add_message(lsn_type{0x11},
+                        relation_message(16385, "nodes", "node_id"));
+    builder.add_message(lsn_type{0x1a}, insert_message(16385, "10", "3", "1"));
+    builder.add_message(lsn_type{(1ULL << 32U) + 0x1b}, commit_message());
+
+    REQUIRE(builder.lsn() == "1/1B");
+    REQUIRE(builder.committed_data() == "0/1A 500 N n10 v1 c3\n"
+                                        "1/1B 500 C\n");
+}
+
+TEST_CASE("log builder with records")
+{
+    pgoutput::log_builder text_builder;
+    pgoutput::log_builder records_builder{
+        pgoutput::stream_store::default_spill_size,
+        pgoutput::log_format::records};
+
+    for (auto *builder : {&text_builder, &records_builder}) {
+        builder->add_message("0/10", begin_message(500));
+        builder->add_message("0/11",
+                             relation_message(16385, "nodes", "node_id"));
+        builder->add_message("0/12", insert_message(16385, "10", "3", "1"));
+        builder->add_message("0/13",
+                             update_message(16385, "11", "3", "2", nullptr));
+        builder->add_message("0/14",
+                             update_message(16385, "12", "3", "2", "0"));
+        builder->add_message("1/15", commit_message());
+
+        builder->add_message("1/20", stream_start_message(600));
+        builder->add_message(
+            "1/21", streamed(600, insert_message(16385, "13", "4", "1")));
+        builder->add_message("1/22", stream_stop_message());
+        builder->add_message("1/23", stream_commit_message(600));
+    }
+
+    REQUIRE(records_builder.lsn() == "1/23");
+    REQUIRE(records_builder.has_actual_data());
+
+    auto const records = records_builder.committed_data();
+    REQUIRE(records.size() == 6 * sizeof(blog::record));
+
+    blog::record rec{};
+    records.copy(reinterpret_cast<char *>(&rec), sizeof(rec),
+                 sizeof(blog::record));
+    REQUIRE(rec.lsn == 0x13);
+    REQUIRE(rec.xid == 500);
+    REQUIRE(rec.op == 'R');
+    REQUIRE(rec.redaction == blog::no_redaction);
+
+    std::string text;
+    for (std::size_t i = 0; i < records.size(); i += sizeof(blog::record)) {
+        records.copy(reinterpret_cast<char *>(&rec), sizeof(rec), i);
+        blog::append_text(&text, rec);
+    }
+    REQUIRE(text == text_builder.committed_data());
+}
+
+TEST_CASE("log builder with records and numeric LSNs")
+{
+    pgoutput::log_builder builder{pgoutput::stream_store::default_spill_size,
+                                  pgoutput::log_format::records};
+
+    builder.add_message(lsn_type{0x10}, begin_message(500));
+    builder.add_message(lsn_type{0x11},
+                        relation_message(16385, "nodes", "node_id"));
+    builder.add_message(lsn_type{0x1a}, insert_message(16385, "10", "3", "1"));
+    builder.add_message(lsn_type{(1ULL << 32U) + 0x1b}, commit_message());
+
+    REQUIRE(builder.lsn() == "1/1B");
+    REQUIRE(builder.committed_data().size() == 2 * sizeof(blog::record));
+
+    blog::record rec{};
+    builder.committed_data().copy(reinterpret_cast<char *>(&rec),
+                                  sizeof(rec), sizeof(blog::record));
+    REQUIRE(rec.lsn == (1ULL << 32U) + 0x1b);
+    REQUIRE(rec.xid == 500);
+    REQUIRE(rec.op == 'C');
+}
+
+TEST_CASE("log builder data written out in the middle of a transaction")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message("0/10", begin_message(500));
+    builder.add_message("0/11", relation_message(16385, "nodes", "node_id"));
+    builder.add_message("0/12", insert_message(16385, "10", "3", "1"));
+
+    REQUIRE(builder.data() == "0/12 500 N n10 v1 c3\n");
+    REQUIRE(builder.committed_data().empty());
+    builder.clear_data();
+
+    builder.add_message("0/13", insert_message(16385, "11", "3", "1"));
+    builder.add_message("0/14", commit_message());
+
+    REQUIRE(builder.has_commits());
+    REQUIRE(builder.has_actual_data());
+    REQUIRE(builder.lsn() == "0/14");
+    REQUIRE(builder.data() == "0/13 500 N n11 v1 c3\n"
+                              "0/14 500 C\n");
+    REQUIRE(builder.committed_data() == builder.data());
+}
+
+TEST_CASE("log builder with redaction only")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message("0/10", begin_message(500));
+    builder.add_message("0/11", relation_message(16385, "nodes", "node_id"));
+    builder.add_message("0/12", update_message(16385, "10", "3", "1", "1"));
+    builder.add_message("0/13", commit_message());
+
+    REQUIRE(builder.has_commits());
+    REQUIRE_FALSE(builder.has_actual_data());
+    REQUIRE(builder.committed_data() == "0/12 500 R n10 v1 c3 1\n"
+                                        "0/13 500 C\n");
+}
+
+TEST_CASE("log builder with streamed transactions")
+{
+    pgoutput::log_builder builder;
+
+    builder.add_message("0/10", stream_start_message(600));
+    builder.add_message(
+        "0/11", streamed(600, relation_message(16385, "nodes", "node_id")));
+    builder.add_message("0/12",
+                        streamed(600, insert_message(16385, "10", "3", "1")));
+    builder.add_message("0/13", stream_stop_message());
+
+    // a normal transaction committed in between
+    builder.add_message("0/20", begin_message(601));
+    builder.add_message("0/21", insert_message(16385, "11", "4", "1"));
+    builder.add_message("0/22", commit_message());
+
+    builder.add_message("0/30", stream_start_message(600));
+    builder.add_message("0/31",
+                        streamed(600, insert_message(16385, "12", "3", "1")));
+    builder.add_message("0/32", stream_stop_message());
+
+    REQUIRE(builder.lsn() == "0/22");
+    REQUIRE(builder.data() == "0/21 601 N n11 v1 c4\n"
+                              "0/22 601 C\n");
+
+    builder.add_message("0/40", stream_commit_message(600));
+
+    REQUIRE(builder.has_commits());
+    REQUIRE(builder.has_actual_data());
+    REQUIRE(builder.lsn() == "0/40");
+    REQUIRE(builder.committed_data() == "0/21 601 N n11 v1 c4\n"
+                                        "0/22 601 C\n"
+                                        "0/12 600 N n10 v1 c3\n"
+                                        "0/31 600 N n12 v1 c3\n"
+                                        "0/40 600 C\n");
+}
+
+TEST_CASE("log builder with aborted streamed transactions")
+{
+    // with a spill size of 1 all lines go through the spill file
+    std::size_t const spill_size = GENERATE(1, 1024);
+    pgoutput::log_builder builder{spill_size};
+
+    builder.add_message("0/10", stream_start_message(600));
+    builder.add_message(
+        "0/11", streamed(600, relation_message(16385, "nodes", "node_id")));
+    builder.add_message("0/12",
+                        streamed(600, insert_message(16385, "10", "3", "1")));
+    builder.add_message("0/13",
+                        streamed(602, insert_message(16385, "11", "3", "1")));
+    builder.add_message("0/14",
+                        streamed(603, insert_message(16385, "12", "3", "1")));
+    builder.add_message("0/15", stream_stop_message());
+
+    builder.add_message("0/20", stream_start_message(610));
+    builder.add_message("0/21",
+                        streamed(610, insert_message(16385, "20", "4", "1")));
+    builder.add_message("0/22", stream_stop_message());
+
+    builder.add_message("0/30", stream_start_message(600));
+    builder.add_message(
+        "0/31", streamed(600, update_message(16385, "10", "3", "1", "1")));
+    builder.add_message("0/32", stream_stop_message());
+
+    // whole transaction 610 and subtransaction 602 of 600 are rolled back
+    builder.add_message("0/40", stream_abort_message(610, 610));
+    builder.add_message("0/41", stream_abort_message(600, 602));
+    REQUIRE_FALSE(builder.has_commits());
+
+    builder.add_message("0/50", stream_commit_message(600));
+    builder.add_message("0/51", stream_commit_message(610));
+
+    REQUIRE(builder.has_commits());
+    REQUIRE(builder.has_actual_data());
+    REQUIRE(builder.lsn() == "0/51");
+    REQUIRE(builder.committed_data() == "0/12 600 N n10 v1 c3\n"
+                                        "0/14 600 N n12 v1 c3\n"
+                                        "0/31 600 R n10 v1 c3 1\n"
+                                        "0/50 600 C\n");
+}
+
+TEST_CASE("stream store without new objects after subtransaction abort")
+{
+    pgoutput::stream_store store{1};
+
+    store.add(600, 600, "0/10 600 R n10 v1 c3 1\n", false);
+    store.add(600, 601, "0/11 600 N n11 v1 c3\n", true);
+    store.abort(600, 601);
+    REQUIRE(store.size() == 1);
+
+    std::string out;
+    REQUIRE_FALSE(store.commit(600, &out));
+    REQUIRE(out == "0/10 600 R n10 v1 c3 1\n");
+    REQUIRE(store.size() == 0);
+}
@@ -0,0 +1,279 @@
+#include <catch.hpp>
+
+#include "pgoutput-messages.hpp"
+#include "pipeline.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Batch of messages looking like a pq::result
+class test_batch
+{
+public:
+    void add(std::string lsn, std::string message)
+    {
+        m_rows.emplace_back(std::move(lsn), std::move(message));
+    }
+
+    explicit operator bool() const noexcept { return !m_rows.empty(); }
+
+    [[nodiscard]] int size() const noexcept
+    {
+        return static_cast<int>(m_rows.size());
+    }
+
+    [[nodiscard]] std::string_view get(int row, int col) const noexcept
+    {
+        auto const &r = m_rows[static_cast<std::size_t>(row)];
+        return col == 0 ? r.first : r.second;
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> m_rows;
+};
+
+// 100 transactions with 10 inserts each, in batches of 7 messages
+std::vector<test_batch> create_batches()
+{
+    std::vector<test_batch> batches;
+    test_batch batch;
+    int n = 0;
+
+    auto add = [&](std::string message) {
+        batch.add("0/" + std::to_string(++n), std::move(message));
+        if (batch.size() == 7) {
+            batches.push_back(std::move(batch));
+            batch = test_batch{};
+        }
+    };
+
+    add(relation_message(16385, "nodes", "node_id"));
+    for (uint32_t xid = 500; xid < 600; ++xid) {
+        add(begin_message(xid));
+        for (int i = 0; i < 10; ++i) {
+            add(insert_message(16385, std::to_string(xid * 10 + i), "3", "1"));
+        }
+        add(commit_message());
+    }
+    batches.push_back(std::move(batch));
+
+    return batches;
+}
+
+// Transactions of different sizes with updates, empty transactions, a
+// large transaction, changed relation metadata, and an unfinished
+// transaction at the end, in batches of 100 messages
+std::vector<test_batch> create_mixed_batches()
+{
+    std::vector<test_batch> batches;
+    test_batch batch;
+    int n = 0;
+
+    auto add = [&](std::string message) {
+        batch.add("0/" + std::to_string(++n), std::move(message));
+        if (batch.size() == 100) {
+            batches.push_back(std::move(batch));
+            batch = test_batch{};
+        }
+    };
+
+    add(relation_message(16385, "nodes", "node_id"));
+    add(relation_message(16386, "ways", "way_id"));
+    for (uint32_t xid = 500; xid < 800; ++xid) {
+        add(begin_message(xid));
+        if (xid == 600) {
+            add(relation_message(16385, "relations", "relation_id"));
+        }
+        int const changes = (xid == 700) ? 3000 : static_cast<int>(xid % 37);
+        for (int i = 0; i < changes; ++i) {
+            auto const id = std::to_string(xid * 10000 + i);
+            if (i % 5 == 4) {
+                add(update_message(16385, id, "3", "2", "1"));
+            } else {
+                add(insert_message(i % 3 ? 16385 : 16386, id, "3", "1"));
+            }
+        }
+        add(commit_message());
+    }
+    add(begin_message(800));
+    add(insert_message(16385, "1", "3", "1"));
+    batches.push_back(std::move(batch));
+
+    return batches;
+}
+
+} // anonymous namespace
+
+TEST_CASE("bounded queue")
+{
+    bounded_queue<int> queue{2};
+
+    bool pushed = true;
+    std::thread producer{[&] {
+        for (int i = 0; i < 100; ++i) {
+            pushed = pushed && queue.push(int{i});
+        }
+        queue.close();
+    }};
+
+    int expected = 0;
+    while (auto const item = queue.pop()) {
+        REQUIRE(*item == expected);
+        ++expected;
+    }
+    producer.join();
+
+    REQUIRE(pushed);
+    REQUIRE(expected == 100);
+    REQUIRE_FALSE(queue.push(1));
+}
+
+TEST_CASE("decode log with and without pipeline")
+{
+    auto const batches = create_batches();
+
+    pgoutput::log_builder builder;
+    for (auto const &batch : batches) {
+        for (int row = 0; row < batch.size(); ++row) {
+            builder.add_message(batch.get(row, 0), batch.get(row, 1));
+        }
+    }
+
+    auto const run = [&](bool pipelined, std::string *out) {
+        std::size_t next = 0;
+        std::size_t writes = 0;
+        auto const result = decode_log(
+            [&] {
+                return next < batches.size() ? batches[next++] : test_batch{};
+            },
+            [&](std::string_view data) {
+                out->append(data);
+                ++writes;
+            },
+            1000, pipelined);
+        REQUIRE(writes > 10);
+        return result;
+    };
+
+    std::string single;
+    auto const result_single = run(false, &single);
+
+    std::string pipelined;
+    auto const result_pipelined = run(true, &pipelined);
+
+    REQUIRE(result_single.entries == 1201);
+    REQUIRE(result_single.lsn == "0/1201");
+    REQUIRE(result_single.has_actual_data);
+    REQUIRE(single == builder.data());
+
+    REQUIRE(result_pipelined.entries == result_single.entries);
+    REQUIRE(result_pipelined.lsn == result_single.lsn);
+    REQUIRE(result_pipelined.has_actual_data);
+    REQUIRE(pipelined == single);
+}
+
+TEST_CASE("decode log pipeline passes on errors")
+{
+    auto const batches = create_batches();
+    std::size_t next = 0;
+
+    REQUIRE_THROWS_AS(
+        decode_log(
+            [&] {
+                return next < batches.size() ? batches[next++] : test_batch{};
+            },
+            [&](std::string_view /*data*/) {
+                throw std::runtime_error{"disk full"};
+            },
+            1000, true),
+        std::runtime_error);
+}
+
+TEST_CASE("parallel decoding gives the same result as a single decoder")
+{
+    auto const batches = create_mixed_batches();
+
+    pgoutput::log_builder builder;
+    std::size_t entries = 0;
+    for (auto const &batch : batches) {
+        for (int row = 0; row < batch.size(); ++row) {
+            builder.add_message(batch.get(row, 0), batch.get(row, 1));
+        }
+        entries += static_cast<std::size_t>(batch.size());
+    }
+
+    auto const threads = GENERATE(2U, 3U, 8U);
+    auto const buffer_size = GENERATE(std::size_t{1000}, std::size_t{100000},
+                                      std::size_t{10000000});
+
+    std::size_t next = 0;
+    std::string out;
+    auto const result = decode_log(
+        [&] { return next < batches.size() ? batches[next++] : test_batch{}; },
+        [&](std::string_view data) { out.append(data); }, buffer_size, true,
+        threads);
+
+    REQUIRE(result.entries == entries);
+    REQUIRE(result.lsn == builder.lsn());
+    REQUIRE(result.has_actual_data);
+    REQUIRE(out == builder.data());
+}
+
+TEST_CASE("parallel decoding of streamed transactions fails")
+{
+    test_batch batch;
+    batch.add("0/1", stream_start_message(600));
+
+    bool done = false;
+    REQUIRE_THROWS(decode_log(
+        [&] {
+            if (done) {
+                return test_batch{};
+            }
+            done = true;
+            return batch;
+        },
+        [&](std::string_view /*data*/) {}, 1000, true, 2));
+}
+
+TEST_CASE("decode log with only chunks of a streamed transaction in progress")
+{
+    // A peek with a limit on the number of changes can stop in the middle
+    // of a streamed transaction, before anything was committed
+    test_batch batch;
+    batch.add("0/10", stream_start_message(600));
+    batch.add("0/11",
+              streamed(600, relation_message(16385, "nodes", "node_id")));
+    for (int i = 0; i < 10; ++i) {
+        batch.add("0/" + std::to_string(12 + i),
+                  streamed(600, insert_message(16385, std::to_string(10 + i),
+                                               "3", "1")));
+    }
+    batch.add("0/30", stream_stop_message());
+
+    auto const pipelined = GENERATE(false, true);
+
+    bool done = false;
+    std::string out;
+    auto const result = decode_log(
+        [&] {
+            if (done) {
+                return test_batch{};
+            }
+            done = true;
+            return batch;
+        },
+        [&](std::string_view data) { out.append(data); }, 1000, pipelined);
+
+    REQUIRE(result.entries == 13);
+    REQUIRE(result.lsn.empty());
+    REQUIRE_FALSE(result.has_actual_data);
+    REQUIRE(out.empty());
+}
@@ -0,0 +1,38 @@
+#include <catch.hpp>
+
+#include "pq.hpp"
+
+#include <cstdint>
+#include <string>
+
+TEST_CASE("Decode integers in binary format")
+{
+    std::int64_t value64 = 0;
+    REQUIRE(pq::from_binary(std::string{"\0\0\0\0\0\0\0\x01", 8}, &value64));
+    REQUIRE(value64 == 1);
+    REQUIRE(pq::from_binary(std::string{"\x01\x02\x03\x04\x05\x06\x07\x08", 8},
+                            &value64));
+    REQUIRE(value64 == 0x0102030405060708);
+    REQUIRE(pq::from_binary(std::string(8, '\xff'), &value64));
+    REQUIRE(value64 == -1);
+
+    std::int32_t value32 = 0;
+    REQUIRE(pq::from_binary(std::string{"\x80\0\0\0", 4}, &value32));
+    REQUIRE(value32 == INT32_MIN);
+}
+
+TEST_CASE("Decode integers with wrong size")
+{
+    std::int64_t value = 42;
+    REQUIRE_FALSE(pq::from_binary(std::string{"\0\0\0\x01", 4}, &value));
+    REQUIRE_FALSE(pq::from_binary(std::string{}, &value));
+    REQUIRE(value == 42);
+}
+
+TEST_CASE("Decode int8 columns")
+{
+    REQUIRE(pq::int64_from_binary(std::string{"\0\0\0\0\0\0\x01\x02", 8}) ==
+            0x0102);
+    REQUIRE_THROWS_AS(pq::int64_from_binary(std::string{"\0\0\0\x01", 4}),
+                      database_error);
+}
@@ -0,0 +1,66 @@
+#include <catch.hpp>
+
+#include "tagstore.hpp"
+
+#include <string>
+#include <string_view>
+#include <utility>
+
+TEST_CASE("Empty tag store")
+{
+    tag_store const tags;
+    REQUIRE(tags.empty());
+    REQUIRE(tags.size() == 0);
+    REQUIRE(tags.begin() == tags.end());
+    REQUIRE(tags.num_keys() == 0);
+}
+
+TEST_CASE("Tags are kept in order and keys are interned")
+{
+    tag_store tags;
+    tags.add(1, 1, "highway", "primary");
+    tags.add(1, 1, "name", "Main Street");
+    tags.add(2, 3, "highway", "");
+    tags.add(4, 1, "name", "Nebenstraße");
+
+    REQUIRE(tags.size() == 4);
+    REQUIRE(tags.num_keys() == 2);
+
+    auto it = tags.begin();
+    REQUIRE(it->id == 1);
+    REQUIRE(it->version == 1);
+    REQUIRE(tags.key(*it) == "highway");
+    REQUIRE(tags.value(*it) == "primary");
+    ++it;
+    REQUIRE(tags.key(*it) == "name");
+    REQUIRE(tags.value(*it) == "Main Street");
+    ++it;
+    REQUIRE(it->id == 2);
+    REQUIRE(it->version == 3);
+    REQUIRE(tags.key(*it) == "highway");
+    REQUIRE(tags.value(*it).empty());
+    ++it;
+    REQUIRE(it->id == 4);
+    REQUIRE(tags.value(*it) == "Nebenstraße");
+    ++it;
+    REQUIRE(it == tags.end());
+}
+
+TEST_CASE("Keys stay valid when keys are added or the store is moved")
+{
+    tag_store tags;
+    for (int i = 0; i < 1000; ++i) {
+        std::string const key = "a_rather_long_key_number_" + std::to_string(i);
+        tags.add(i, 1, key, "x");
+        tags.add(i, 1, "amenity", "y");
+    }
+
+    REQUIRE(tags.num_keys() == 1001);
+    REQUIRE(tags.key(*tags.begin()) == "a_rather_long_key_number_0");
+    REQUIRE(tags.key(*(tags.end() - 1)) == "amenity");
+
+    tag_store moved{std::move(tags)};
+    moved.add(1001, 1, "a_rather_long_key_number_0", "z");
+    REQUIRE(moved.num_keys() == 1001);
+    REQUIRE(moved.key(*moved.begin()) == "a_rather_long_key_number_0");
+}
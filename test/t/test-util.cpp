@@ -11,4 +11,21 @@ TEST_CASE("create_replication_log_name")
             "osm-repl-1970-01-01T00:00:00Z-foo.log");
     REQUIRE(create_replication_log_name("bar", 1345834023) ==
             "osm-repl-2012-08-24T18:47:03Z-bar.log");
+    REQUIRE(create_replication_log_name("baz", 0, ".blog") ==
+            "osm-repl-1970-01-01T00:00:00Z-baz.blog");
+}
+
+TEST_CASE("is_log_file_name")
+{
+    REQUIRE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log"));
+    REQUIRE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log.gz"));
+    REQUIRE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log.zst"));
+    REQUIRE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.blog"));
+    REQUIRE_FALSE(
+        is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log.done"));
+    REQUIRE_FALSE(
+        is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log.gz.done"));
+    REQUIRE_FALSE(
+        is_log_file_name("osm-repl-2012-08-24T18:47:03Z-pending.log.new"));
+    REQUIRE_FALSE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z.gz"));
 }